@@ -1,9 +1,14 @@
 #include "BVH.h"
 
+#include <bit>
+#include <filesystem>
+#include <fstream>
 #include <queue>
 #include <sstream>
 
-#include "SobolMatrices.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "Profiler.h"
 #include "psr.h"
 
 // ---------------
@@ -11,6 +16,12 @@
 // ---------------
 BVH::BVH(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, unsigned int primsCnt) :
 	m_pDevice(pDevice), m_pDeviceContext(pDeviceContext) {
+	sce::Psr::init();
+
+	// without device only building is available, as in headless benchmarks
+	if (!m_pDevice)
+		return;
+
 	HRESULT hr{ S_OK };
 
 	// vertex buffer
@@ -114,106 +125,68 @@ BVH::BVH(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, unsigned in
 		THROW_IF_FAILED(hr);
 	}
 
-	// bvh structured buffer
-	{
-		D3D11_BUFFER_DESC desc{
-			.ByteWidth{ (2 * (2 * primsCnt) - 1) * sizeof(BVH::BVHNode) },
-			.Usage{ D3D11_USAGE_DYNAMIC },
-			.BindFlags{ D3D11_BIND_SHADER_RESOURCE },
-			.CPUAccessFlags{ D3D11_CPU_ACCESS_WRITE },
-			.MiscFlags{ D3D11_RESOURCE_MISC_BUFFER_STRUCTURED },
-			.StructureByteStride{ sizeof(BVH::BVHNode) }
-		};
-
-		hr = m_pDevice->CreateBuffer(&desc, nullptr, &m_pBVHBuffer);
-		THROW_IF_FAILED(hr);
-
-		hr = setResourceName(m_pBVHBuffer, "BVHBuffer");
-		THROW_IF_FAILED(hr);
-
-		D3D11_SHADER_RESOURCE_VIEW_DESC descSRV{
-			.Format{ DXGI_FORMAT_UNKNOWN },
-			.ViewDimension{ D3D11_SRV_DIMENSION_BUFFER },
-			.Buffer{
-				.FirstElement{ 0 },
-				.NumElements{ 2 * (2 * primsCnt) - 1 }
-			}
-		};
-
-		hr = m_pDevice->CreateShaderResourceView(m_pBVHBuffer, &descSRV, &m_pBVHBufferSRV);
-		THROW_IF_FAILED(hr);
-
-		hr = setResourceName(m_pBVHBufferSRV, "BVHBufferSRV");
-		THROW_IF_FAILED(hr);
-	}
-
-	// create prim indices buffer
-	{
-		D3D11_BUFFER_DESC desc{
-			.ByteWidth{ (2 * primsCnt) * sizeof(XMINT4) },
-			.Usage{ D3D11_USAGE_DYNAMIC },
-			.BindFlags{ D3D11_BIND_SHADER_RESOURCE },
-			.CPUAccessFlags{ D3D11_CPU_ACCESS_WRITE },
-			.MiscFlags{ D3D11_RESOURCE_MISC_BUFFER_STRUCTURED },
-			.StructureByteStride{ sizeof(XMINT4) }
-		};
-
-		hr = m_pDevice->CreateBuffer(&desc, nullptr, &m_pPrimIdsBuffer);
-		THROW_IF_FAILED(hr);
+	// structured buffers are sized for binary tree without splits and grow on demand
+	reserveBuffer(&m_pBVHBuffer, &m_pBVHBufferSRV, m_bvhBufferCapacity, sizeof(BVHNode), 2 * primsCnt - 1, "BVHBuffer");
+	reserveBuffer(&m_pPrimIdsBuffer, &m_pPrimIdsBufferSRV, m_primIdsBufferCapacity, sizeof(UINT), primsCnt, "PrimIdsBuffer");
+	reserveBuffer(&m_pFlatTrisBuffer, &m_pFlatTrisBufferSRV, m_flatTrisBufferCapacity, sizeof(FlatTri), primsCnt, "FlatTrisBuffer");
+	reserveBuffer(&m_pModelBuffer, &m_pModelBufferSRV, m_modelBufferCapacity, sizeof(ModelBuffer), 64, "BVHRendererModelBuffer");
+	reserveBuffer(&m_pPrimHighlightsBuffer, &m_pPrimHighlightsBufferSRV, m_primHighlightsBufferCapacity, sizeof(UINT), (primsCnt + 15) / 16, "PrimHighlightsBuffer");
+}
 
-		hr = setResourceName(m_pPrimIdsBuffer, "PrimIdsBuffer");
-		THROW_IF_FAILED(hr);
+void BVH::reserveBuffer(
+	ID3D11Buffer** ppBuffer,
+	ID3D11ShaderResourceView** ppSRV,
+	UINT& capacity,
+	UINT stride,
+	UINT cnt,
+	const std::string& name
+) {
+	if (cnt <= capacity)
+		return;
 
-		D3D11_SHADER_RESOURCE_VIEW_DESC descSRV{
-			.Format{ DXGI_FORMAT_UNKNOWN },
-			.ViewDimension{ D3D11_SRV_DIMENSION_BUFFER },
-			.Buffer{
-				.FirstElement{ 0 },
-				.NumElements{ (2 * primsCnt) }
-			}
-		};
+	capacity = std::max<UINT>(cnt, capacity + capacity / 2);
 
-		hr = m_pDevice->CreateShaderResourceView(m_pPrimIdsBuffer, &descSRV, &m_pPrimIdsBufferSRV);
-		THROW_IF_FAILED(hr);
+	SAFE_RELEASE((*ppSRV));
+	SAFE_RELEASE((*ppBuffer));
 
-		hr = setResourceName(m_pPrimIdsBufferSRV, "PrimIdsBufferSRV");
-		THROW_IF_FAILED(hr);
-	}
+	D3D11_BUFFER_DESC desc{
+		.ByteWidth{ capacity * stride },
+		.Usage{ D3D11_USAGE_DYNAMIC },
+		.BindFlags{ D3D11_BIND_SHADER_RESOURCE },
+		.CPUAccessFlags{ D3D11_CPU_ACCESS_WRITE },
+		.MiscFlags{ D3D11_RESOURCE_MISC_BUFFER_STRUCTURED },
+		.StructureByteStride{ stride }
+	};
 
-	// create model buffer
-	{
-		D3D11_BUFFER_DESC desc{
-			.ByteWidth{ sizeof(ModelBuffer) * (2 * (2 * primsCnt) - 1) },
-			.Usage{ D3D11_USAGE_DYNAMIC },
-			.BindFlags{ D3D11_BIND_SHADER_RESOURCE },
-			.CPUAccessFlags{ D3D11_CPU_ACCESS_WRITE },
-			.MiscFlags{ D3D11_RESOURCE_MISC_BUFFER_STRUCTURED },
-			.StructureByteStride{ sizeof(ModelBuffer) }
-		};
-		hr = m_pDevice->CreateBuffer(&desc, nullptr, &m_pModelBuffer);
-		THROW_IF_FAILED(hr);
+	HRESULT hr{ m_pDevice->CreateBuffer(&desc, nullptr, ppBuffer) };
+	THROW_IF_FAILED(hr);
 
-		hr = setResourceName(m_pModelBuffer, "BVHRendererModelBuffer");
-		THROW_IF_FAILED(hr);
+	hr = setResourceName(*ppBuffer, name);
+	THROW_IF_FAILED(hr);
 
-		D3D11_SHADER_RESOURCE_VIEW_DESC descSRV{
-			.Format{ DXGI_FORMAT_UNKNOWN },
-			.ViewDimension{ D3D11_SRV_DIMENSION_BUFFER },
-			.Buffer{.NumElements{ 2 * (2 * primsCnt) - 1 } }
-		};
-		hr = m_pDevice->CreateShaderResourceView(m_pModelBuffer, &descSRV, &m_pModelBufferSRV);
-		THROW_IF_FAILED(hr);
+	D3D11_SHADER_RESOURCE_VIEW_DESC descSRV{
+		.Format{ DXGI_FORMAT_UNKNOWN },
+		.ViewDimension{ D3D11_SRV_DIMENSION_BUFFER },
+		.Buffer{
+			.FirstElement{ 0 },
+			.NumElements{ capacity }
+		}
+	};
 
-		hr = setResourceName(m_pModelBufferSRV, "BVHRendererModelBufferSRV");
-		THROW_IF_FAILED(hr);
-	}
+	hr = m_pDevice->CreateShaderResourceView(*ppBuffer, &descSRV, ppSRV);
+	THROW_IF_FAILED(hr);
 
-	sce::Psr::init();
+	hr = setResourceName(*ppSRV, name + "SRV");
+	THROW_IF_FAILED(hr);
 }
 
 void BVH::term() {
 	sce::Psr::shutDown();
 
+	SAFE_RELEASE(m_pPrimHighlightsBufferSRV);
+	SAFE_RELEASE(m_pPrimHighlightsBuffer);
+	SAFE_RELEASE(m_pFlatTrisBufferSRV);
+	SAFE_RELEASE(m_pFlatTrisBuffer);
 	SAFE_RELEASE(m_pPrimIdsBufferSRV);
 	SAFE_RELEASE(m_pPrimIdsBuffer);
 	SAFE_RELEASE(m_pBVHBufferSRV);
@@ -229,9 +202,7 @@ void BVH::term() {
 void BVH::updateRenderBVH() {
 	m_modelBuffers.clear();
 
-	for (int i{}; i < m_primsCnt; ++i) {
-		m_primRefs[i].isAABBHighlight = 0;
-	}
+	m_primHighlights.assign((m_primsCntOrig + 15) / 16, 0);
 
 	if (m_algBuild == 5 || m_toQBVH) {
 		if (m_aabbHighlightAll) {
@@ -270,7 +241,7 @@ void BVH::updateRenderBVH() {
 				if (m_aabbHighlightPrims && m_nodes[nodeId].leftCntPar.y) {
 					for (int i{}; i < m_nodes[nodeId].leftCntPar.y; ++i) {
 						UINT index{ m_primRefs[m_nodes[nodeId].leftCntPar.x + i].primId };
-						m_primRefs[index].isAABBHighlight = 1;
+						highlightPrim(index, PrimHighlightAABB);
 					}
 				}
 				});
@@ -298,7 +269,7 @@ void BVH::updateRenderBVH() {
 				preForEachQuad(nodeId, [&](int n) {
 					for (int i{}; i < m_nodes[n].leftCntPar.y; ++i) {
 						UINT index{ m_primRefs[m_nodes[n].leftCntPar.x + i].primId };
-						m_primRefs[index].isAABBHighlight = 1;
+						highlightPrim(index, PrimHighlightAABB);
 					}
 				});
 			}
@@ -306,7 +277,7 @@ void BVH::updateRenderBVH() {
 			if (m_aabbHighlightPrims && m_nodes[nodeId].leftCntPar.y) {
 				for (int i{}; i < m_nodes[nodeId].leftCntPar.y; ++i) {
 					UINT index{ m_primRefs[m_nodes[nodeId].leftCntPar.x + i].primId };
-					m_primRefs[index].isAABBHighlight = 1;
+					highlightPrim(index, PrimHighlightAABB);
 				}
 			}
 
@@ -340,7 +311,7 @@ void BVH::updateRenderBVH() {
 					if (m_aabbHighlightPrims && m_nodes[sibling].leftCntPar.y) {
 						for (int i{}; i < m_nodes[sibling].leftCntPar.y; ++i) {
 							UINT index{ m_primRefs[m_nodes[sibling].leftCntPar.x + i].primId };
-							m_primRefs[index].isAABBHighlight = 1;
+							highlightPrim(index, PrimHighlightAABB);
 						}
 					}
 				}
@@ -363,7 +334,7 @@ void BVH::updateRenderBVH() {
 					if (m_aabbHighlightPrims && m_nodes[child].leftCntPar.y) {
 						for (int i{}; i < m_nodes[child].leftCntPar.y; ++i) {
 							UINT index{ m_primRefs[m_nodes[child].leftCntPar.x + i].primId };
-							m_primRefs[index].isAABBHighlight = 1;
+							highlightPrim(index, PrimHighlightAABB);
 						}
 					}
 				}
@@ -410,7 +381,7 @@ void BVH::updateRenderBVH() {
 				if (m_aabbHighlightPrims && m_nodes[nodeId].leftCntPar.y) {
 					for (int i{}; i < m_nodes[nodeId].leftCntPar.y; ++i) {
 						UINT index{ m_primRefs[m_nodes[nodeId].leftCntPar.x + i].primId };
-						m_primRefs[index].isAABBHighlight = 1;
+						highlightPrim(index, PrimHighlightAABB);
 					}
 				}
 				});
@@ -440,7 +411,7 @@ void BVH::updateRenderBVH() {
 				preForEach(nodeId, [&](int n) {
 					for (int i{}; i < m_nodes[n].leftCntPar.y; ++i) {
 						UINT index{ m_primRefs[m_nodes[n].leftCntPar.x + i].primId };
-						m_primRefs[index].isAABBHighlight = 1;
+						highlightPrim(index, PrimHighlightAABB);
 					}
 				});
 			}
@@ -448,7 +419,7 @@ void BVH::updateRenderBVH() {
 			if (m_aabbHighlightPrims && m_nodes[nodeId].leftCntPar.y) {
 				for (int i{}; i < m_nodes[nodeId].leftCntPar.y; ++i) {
 					UINT index{ m_primRefs[m_nodes[nodeId].leftCntPar.x + i].primId };
-					m_primRefs[index].isAABBHighlight = 1;
+					highlightPrim(index, PrimHighlightAABB);
 				}
 			}
 
@@ -480,7 +451,7 @@ void BVH::updateRenderBVH() {
 				if (m_aabbHighlightPrims && m_nodes[sibling].leftCntPar.y) {
 					for (int i{}; i < m_nodes[sibling].leftCntPar.y; ++i) {
 						UINT index{ m_primRefs[m_nodes[sibling].leftCntPar.x + i].primId };
-						m_primRefs[index].isAABBHighlight = 1;
+						highlightPrim(index, PrimHighlightAABB);
 					}
 				}
 			}
@@ -501,7 +472,7 @@ void BVH::updateRenderBVH() {
 					if (m_aabbHighlightPrims && m_nodes[child].leftCntPar.y) {
 						for (int i{}; i < m_nodes[child].leftCntPar.y; ++i) {
 							UINT index{ m_primRefs[m_nodes[child].leftCntPar.x + i].primId };
-							m_primRefs[index].isAABBHighlight = 1;
+							highlightPrim(index, PrimHighlightAABB);
 						}
 					}
 				}
@@ -512,6 +483,8 @@ void BVH::updateRenderBVH() {
 		}
 	}
 
+	reserveBuffer(&m_pModelBuffer, &m_pModelBufferSRV, m_modelBufferCapacity, sizeof(ModelBuffer), static_cast<UINT>(m_modelBuffers.size()), "BVHRendererModelBuffer");
+
 	D3D11_MAPPED_SUBRESOURCE subres{};
 	THROW_IF_FAILED(m_pDeviceContext->Map(m_pModelBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subres));
 	memcpy(subres.pData, m_modelBuffers.data(), m_modelBuffers.size() * sizeof(ModelBuffer));
@@ -521,15 +494,41 @@ void BVH::updateRenderBVH() {
 }
 
 void BVH::updateBuffers() {
+	PROFILE_ZONE("updateBuffers");
+
+	reserveBuffer(&m_pBVHBuffer, &m_pBVHBufferSRV, m_bvhBufferCapacity, sizeof(BVHNode), static_cast<UINT>(m_nodes.size()), "BVHBuffer");
+	reserveBuffer(&m_pPrimIdsBuffer, &m_pPrimIdsBufferSRV, m_primIdsBufferCapacity, sizeof(UINT), static_cast<UINT>(m_primRefs.size()), "PrimIdsBuffer");
+	reserveBuffer(&m_pFlatTrisBuffer, &m_pFlatTrisBufferSRV, m_flatTrisBufferCapacity, sizeof(FlatTri), static_cast<UINT>(m_flatTris.size()), "FlatTrisBuffer");
+
 	D3D11_MAPPED_SUBRESOURCE subres{};
 	THROW_IF_FAILED(m_pDeviceContext->Map(m_pBVHBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subres));
 	memcpy(subres.pData, m_nodes.data(), sizeof(BVHNode) * m_nodes.size());
 	m_pDeviceContext->Unmap(m_pBVHBuffer, 0);
 
+	// prim ids are packed out of prim refs
 	subres = {};
 	THROW_IF_FAILED(m_pDeviceContext->Map(m_pPrimIdsBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subres));
-	memcpy(subres.pData, m_primRefs.data(), sizeof(XMINT4) * m_primRefs.size());
+	UINT* pPrimIds{ static_cast<UINT*>(subres.pData) };
+	for (size_t i{}; i < m_primRefs.size(); ++i) {
+		pPrimIds[i] = m_primRefs[i].primId;
+	}
 	m_pDeviceContext->Unmap(m_pPrimIdsBuffer, 0);
+
+	if (isPrimHighlights() && !m_primHighlights.empty()) {
+		reserveBuffer(&m_pPrimHighlightsBuffer, &m_pPrimHighlightsBufferSRV, m_primHighlightsBufferCapacity, sizeof(UINT), static_cast<UINT>(m_primHighlights.size()), "PrimHighlightsBuffer");
+
+		subres = {};
+		THROW_IF_FAILED(m_pDeviceContext->Map(m_pPrimHighlightsBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subres));
+		memcpy(subres.pData, m_primHighlights.data(), sizeof(uint32_t) * m_primHighlights.size());
+		m_pDeviceContext->Unmap(m_pPrimHighlightsBuffer, 0);
+	}
+
+	if (isFlatTris()) {
+		subres = {};
+		THROW_IF_FAILED(m_pDeviceContext->Map(m_pFlatTrisBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subres));
+		memcpy(subres.pData, m_flatTris.data(), sizeof(FlatTri) * m_flatTris.size());
+		m_pDeviceContext->Unmap(m_pFlatTrisBuffer, 0);
+	}
 }
 
 void BVH::renderBVHImGui() {
@@ -704,6 +703,46 @@ void BVH::renderBVHImGui() {
 		ImGui::Checkbox("BVH to QBVH", &m_toQBVH);
 	}
 
+	ImGui::Text(" ");
+	ImGui::Text("SAH costs:");
+	ImGui::DragFloat("Node", &m_costTraversal, 0.01f, 0.01f, 16.f);
+	ImGui::DragFloat("Wide node", &m_costTraversalWide, 0.01f, 0.01f, 16.f);
+	ImGui::DragFloat("Triangle", &m_costIntersect, 0.01f, 0.01f, 16.f);
+	if (ImGui::Button("Load bvh.params"))
+		loadParams("bvh.params");
+
+	ImGui::Text(" ");
+	ImGui::Text("Nodes layout:");
+
+	bool isLayoutBuilt{ m_algLayout == 0 };
+	ImGui::Checkbox("As built", &isLayoutBuilt);
+	if (isLayoutBuilt) m_algLayout = 0;
+
+	bool isLayoutDFS{ m_algLayout == 1 };
+	ImGui::Checkbox("DFS, larger child first", &isLayoutDFS);
+	if (isLayoutDFS) m_algLayout = 1;
+
+	bool isLayoutTreelets{ m_algLayout == 2 };
+	ImGui::Checkbox("Treelets", &isLayoutTreelets);
+	if (isLayoutTreelets) m_algLayout = 2;
+
+	bool isLayoutVisits{ m_algLayout == 3 };
+	ImGui::Checkbox("Treelets by visits", &isLayoutVisits);
+	if (isLayoutVisits) m_algLayout = 3;
+
+	if (m_algLayout >= 2) {
+		ImGui::DragInt("Treelet cache lines", &m_layoutTreeletLines, 1, 1, 64);
+	}
+
+	ImGui::Text(" ");
+	ImGui::Checkbox("Flat triangles", &m_flatTrisOn);
+
+	ImGui::Text(" ");
+	ImGui::Checkbox("Use BVH cache", &m_cacheOn);
+	if (m_isCached) {
+		ImGui::Text("Loaded from cache");
+	}
+
 	ImGui::Text(" ");
 
 	ImGui::Text("Statistics:");
@@ -720,6 +759,23 @@ void BVH::renderBVHImGui() {
 	ImGui::Text(" ");
 	ImGui::Text("Min depth: %d", m_depthMin);
 	ImGui::Text("Max depth: %d", m_depthMax);
+	ImGui::Text(" ");
+	ImGui::Text("Prim refs (KB): %.1f", sizeof(PrimRef) * m_primRefs.size() / 1024.f);
+	if (isFlatTris()) {
+		ImGui::Text("Flat triangles (KB): %.1f", sizeof(FlatTri) * m_flatTris.size() / 1024.f);
+	}
+	ImGui::Text(" ");
+	ImGui::Text("Committed memory (KB):");
+	ImGui::Text("CPU nodes: %.1f", sizeof(BVHNode) * m_nodes.capacity() / 1024.f);
+	ImGui::Text("CPU prim refs: %.1f", sizeof(PrimRef) * m_primRefs.capacity() / 1024.f);
+	ImGui::Text("CPU flat triangles: %.1f", sizeof(FlatTri) * m_flatTris.capacity() / 1024.f);
+	ImGui::Text("CPU build prims: %.1f", sizeof(Prim) * m_prims.capacity() / 1024.f);
+	ImGui::Text("CPU tree arrays on last build: %.1f", m_buildMemory / 1024.f);
+	ImGui::Text("GPU nodes: %.1f", sizeof(BVHNode) * m_bvhBufferCapacity / 1024.f);
+	ImGui::Text("GPU prim ids: %.1f", sizeof(UINT) * m_primIdsBufferCapacity / 1024.f);
+	ImGui::Text("GPU prim highlights: %.1f", sizeof(UINT) * m_primHighlightsBufferCapacity / 1024.f);
+	ImGui::Text("GPU flat triangles: %.1f", sizeof(FlatTri) * m_flatTrisBufferCapacity / 1024.f);
+	ImGui::Text("GPU AABBs: %.1f", sizeof(ModelBuffer) * m_modelBufferCapacity / 1024.f);
 
 	ImGui::End();
 
@@ -849,8 +905,10 @@ void BVH::render(ID3D11SamplerState* pSampler, ID3D11Buffer* pSceneBuffer) {
 // ------------
 //	LOGIC PART
 // ------------
-void BVH::init(Vector4* vts, INT vtsCnt, XMINT4* ids, INT idsCnt, Matrix modelMatrix) {
-	m_primsCntOrig = m_primsCnt = idsCnt;
+void BVH::init(const MeshView& mesh, Matrix modelMatrix) {
+	PROFILE_ZONE("init");
+
+	m_primsCntOrig = m_primsCnt = mesh.trisCnt;
 
 	m_nodesUsed = 1;
 	m_leafsCnt = 0;
@@ -860,14 +918,16 @@ void BVH::init(Vector4* vts, INT vtsCnt, XMINT4* ids, INT idsCnt, Matrix modelMa
 	m_prims.resize(m_primsCnt);
 	m_primRefs.clear();
 	m_primRefs.resize(m_primsCnt);
-	m_nodes.resize(2 * (2 * m_primsCnt) - 1);
+	// exact bound without splits, splitting builders grow it on demand
+	m_nodes.resize(2 * m_primsCnt - 1);
 
 	for (UINT i{}; i < m_primsCnt; ++i) {
+		XMUINT3 tri{ mesh.tri(i) };
 		m_prims[i] = {
 			static_cast<int>(i),
-			Vector4::Transform(vts[ids[i].x], modelMatrix),
-			Vector4::Transform(vts[ids[i].y], modelMatrix),
-			Vector4::Transform(vts[ids[i].z], modelMatrix)
+			Vector4::Transform(mesh.vertex(tri.x), modelMatrix),
+			Vector4::Transform(mesh.vertex(tri.y), modelMatrix),
+			Vector4::Transform(mesh.vertex(tri.z), modelMatrix)
 		};
 		m_prims[i].updCtrAndBB();
 
@@ -878,15 +938,50 @@ void BVH::init(Vector4* vts, INT vtsCnt, XMINT4* ids, INT idsCnt, Matrix modelMa
 	}
 }
 
-void BVH::build(Vector4* vts, INT vtsCnt, XMINT4* ids, INT idsCnt, Matrix modelMatrix) {
+void BVH::build(const MeshView& mesh, Matrix modelMatrix) {
+	PROFILE_ZONE("build");
+
+	m_isCached = false;
+	// visit driven layout depends on traced visits which key does not cover
+	if (!m_cacheOn || m_algLayout == 3) {
+		buildTree(mesh, modelMatrix);
+		return;
+	}
+
+	uint64_t key{ cacheKey(mesh, modelMatrix) };
+
+	std::ostringstream path{};
+	path << "bvhcache/" << std::hex << key << ".bvh";
+
+	if (loadCache(path.str(), key, mesh)) {
+		// write time is last use for eviction
+		std::error_code ec{};
+		std::filesystem::last_write_time(path.str(), std::filesystem::file_time_type::clock::now(), ec);
+
+		m_isCached = true;
+		return;
+	}
+
+	buildTree(mesh, modelMatrix);
+
+	PROFILE_ZONE("saveCache");
+	std::error_code ec{};
+	std::filesystem::create_directories("bvhcache", ec);
+	if (saveCache(path.str(), key, mesh))
+		evictCache("bvhcache");
+}
+
+void BVH::buildTree(const MeshView& mesh, Matrix modelMatrix) {
 	if (m_algBuild == 5) {
-		buildPsr(vts, vtsCnt, ids, idsCnt, modelMatrix);
-		m_sahCost = costSAH();
+		buildPsr(mesh, modelMatrix);
+		finalizeTree(mesh, modelMatrix);
 		return;
 	}
 
-	init(vts, vtsCnt, ids, idsCnt, modelMatrix);
+	init(mesh, modelMatrix);
 	if (m_algBuild == 6) {
+		PROFILE_ZONE("subdivideSBVH");
+
 		m_nodes[0].leftCntPar = {
 			0, m_primsCnt, -1, 0
 		};
@@ -918,6 +1013,8 @@ void BVH::build(Vector4* vts, INT vtsCnt, XMINT4* ids, INT idsCnt, Matrix modelM
 		
 	}
 	else if (m_algBuild != 4) {
+		PROFILE_ZONE("subdivide");
+
 		m_nodes[0].leftCntPar = {
 			0, m_primsCnt, -1, 0
 		};
@@ -933,13 +1030,56 @@ void BVH::build(Vector4* vts, INT vtsCnt, XMINT4* ids, INT idsCnt, Matrix modelM
 		buildStochastic();
 	}
 
-	if (m_toQBVH)
+	if (m_toQBVH) {
+		PROFILE_ZONE("toQBVH");
 		binaryBVH2QBVH();
+	}
+
+	finalizeTree(mesh, modelMatrix);
+}
+
+// steps shared by all builders once nodes are built
+void BVH::finalizeTree(const MeshView& mesh, Matrix modelMatrix) {
+	// flat tris of previous build do not match new refs, reorder must not touch them
+	m_flatTris.clear();
+
+	if (m_algLayout) {
+		PROFILE_ZONE("reorderNodes");
+		reorderNodes();
+	}
+
+	if (m_flatTrisOn) {
+		PROFILE_ZONE("buildFlatTris");
+		buildFlatTris(mesh, modelMatrix);
+	}
 
+	PROFILE_ZONE("shrinkToFit & costSAH");
+	shrinkToFit();
 	m_sahCost = costSAH();
 }
 
-void BVH::buildPsr(Vector4* vts, INT vtsCnt, XMINT4* ids, INT idsCnt, Matrix modelMatrix) {
+// call before taking node references, growth moves nodes
+void BVH::reserveNodes(int cnt) {
+	size_t size{ static_cast<size_t>(m_nodesUsed + cnt) };
+	if (size > m_nodes.size())
+		m_nodes.resize(std::max<size_t>(size, m_nodes.size() + m_nodes.size() / 2));
+}
+
+// splits leave spare nodes and refs capacity behind
+void BVH::shrinkToFit() {
+	// tree arrays are at their largest right before trimming
+	m_buildMemory = sizeof(BVHNode) * m_nodes.capacity() + sizeof(PrimRef) * m_primRefs.capacity()
+		+ sizeof(FlatTri) * m_flatTris.capacity() + sizeof(Prim) * m_prims.capacity();
+
+	m_nodes.resize(m_nodesUsed);
+	m_nodes.shrink_to_fit();
+	m_primRefs.shrink_to_fit();
+	m_flatTris.shrink_to_fit();
+}
+
+void BVH::buildPsr(const MeshView& mesh, Matrix modelMatrix) {
+	PROFILE_ZONE("buildPsr");
+
 	sce::Psr::BottomLevelBvhDescriptor descriptor{};
 
     sce::Psr::Cpu::BottomLevelBvhConfig builderConfig{};
@@ -962,15 +1102,13 @@ void BVH::buildPsr(Vector4* vts, INT vtsCnt, XMINT4* ids, INT idsCnt, Matrix mod
 	}
 	sce::Psr::Cpu::checkBottomLevelBvhConfig(builderConfig);
 
-	std::vector<XMUINT3> idsPsr(idsCnt);
-	for (int i{}; i < idsCnt; ++i) idsPsr[i] = {
-		static_cast<unsigned>(ids[i].x),
-		static_cast<unsigned>(ids[i].y),
-		static_cast<unsigned>(ids[i].z)
-	};
-
-	std::vector<XMFLOAT3> vtsPsr(vtsCnt);
-	for (int i{}; i < vtsCnt; ++i) vtsPsr[i] = { vts[i].x, vts[i].y, vts[i].z };
+	// packed vertices and 32 bit indices are passed as is, 16 bit ones are widened
+	std::vector<XMUINT3> idsPsr{};
+	if (mesh.indexSize != sizeof(uint32_t)) {
+		idsPsr.resize(mesh.trisCnt);
+		for (int i{}; i < mesh.trisCnt; ++i) idsPsr[i] = mesh.tri(i);
+	}
+	const void* pTriangles{ idsPsr.empty() ? mesh.pIndices : idsPsr.data() };
 
 	sce::Psr::Cpu::GeometryConfig geometries{};
 	geometries.init();
@@ -978,30 +1116,30 @@ void BVH::buildPsr(Vector4* vts, INT vtsCnt, XMINT4* ids, INT idsCnt, Matrix mod
 		geometries.m_kind = geometries.kMesh;
 		geometries.m_flags = sce::Psr::GeometryFlags::kNone;
 
-		sce::Psr::Cpu::GeometryMeshConfig mesh{};
-		mesh.init();
+		sce::Psr::Cpu::GeometryMeshConfig meshPsr{};
+		meshPsr.init();
 		{
-			mesh.m_vertexData = static_cast<void*>(vtsPsr.data());
-			mesh.m_triangleData = static_cast<void*>(idsPsr.data());
-			mesh.m_triangleFan = nullptr;
-			mesh.m_triangleFanInput = sce::Psr::Cpu::TriangleFanInput::kHighQualityOnTheFly;
-			mesh.m_objectToWorld[ 0] = modelMatrix._11; mesh.m_objectToWorld[ 1] = modelMatrix._12;
-			mesh.m_objectToWorld[ 2] = modelMatrix._13; mesh.m_objectToWorld[ 3] = modelMatrix._14;
-			mesh.m_objectToWorld[ 4] = modelMatrix._21; mesh.m_objectToWorld[ 5] = modelMatrix._22;
-			mesh.m_objectToWorld[ 6] = modelMatrix._23; mesh.m_objectToWorld[ 7] = modelMatrix._24;
-			mesh.m_objectToWorld[ 8] = modelMatrix._31; mesh.m_objectToWorld[ 9] = modelMatrix._32;
-			mesh.m_objectToWorld[10] = modelMatrix._33; mesh.m_objectToWorld[11] = modelMatrix._34;
-			mesh.m_objectToWorld[12] = modelMatrix._41; mesh.m_objectToWorld[13] = modelMatrix._42;
-			mesh.m_objectToWorld[14] = modelMatrix._43; mesh.m_objectToWorld[15] = modelMatrix._44;
-			mesh.m_vertexStride = 12;
-			mesh.m_triangleStride = 12;
-			mesh.m_vertexCount = vtsCnt;
-			mesh.m_triangleCount = idsCnt;
-			mesh.m_vertexFormat = sce::Psr::Cpu::VertexFormat::kFp32x3;
-			mesh.m_triangleFormat = sce::Psr::Cpu::TriangleFormat::kUint32x3;
-		}
-
-		geometries.m_mesh = mesh;
+			meshPsr.m_vertexData = const_cast<XMFLOAT3*>(mesh.pVertices);
+			meshPsr.m_triangleData = const_cast<void*>(pTriangles);
+			meshPsr.m_triangleFan = nullptr;
+			meshPsr.m_triangleFanInput = sce::Psr::Cpu::TriangleFanInput::kHighQualityOnTheFly;
+			meshPsr.m_objectToWorld[ 0] = modelMatrix._11; meshPsr.m_objectToWorld[ 1] = modelMatrix._12;
+			meshPsr.m_objectToWorld[ 2] = modelMatrix._13; meshPsr.m_objectToWorld[ 3] = modelMatrix._14;
+			meshPsr.m_objectToWorld[ 4] = modelMatrix._21; meshPsr.m_objectToWorld[ 5] = modelMatrix._22;
+			meshPsr.m_objectToWorld[ 6] = modelMatrix._23; meshPsr.m_objectToWorld[ 7] = modelMatrix._24;
+			meshPsr.m_objectToWorld[ 8] = modelMatrix._31; meshPsr.m_objectToWorld[ 9] = modelMatrix._32;
+			meshPsr.m_objectToWorld[10] = modelMatrix._33; meshPsr.m_objectToWorld[11] = modelMatrix._34;
+			meshPsr.m_objectToWorld[12] = modelMatrix._41; meshPsr.m_objectToWorld[13] = modelMatrix._42;
+			meshPsr.m_objectToWorld[14] = modelMatrix._43; meshPsr.m_objectToWorld[15] = modelMatrix._44;
+			meshPsr.m_vertexStride = 12;
+			meshPsr.m_triangleStride = 12;
+			meshPsr.m_vertexCount = mesh.verticesCnt;
+			meshPsr.m_triangleCount = mesh.trisCnt;
+			meshPsr.m_vertexFormat = sce::Psr::Cpu::VertexFormat::kFp32x3;
+			meshPsr.m_triangleFormat = sce::Psr::Cpu::TriangleFormat::kUint32x3;
+		}
+
+		geometries.m_mesh = meshPsr;
 	}
 
 	uint32_t geometryCount{ 1 };
@@ -1041,7 +1179,7 @@ void BVH::buildPsr(Vector4* vts, INT vtsCnt, XMINT4* ids, INT idsCnt, Matrix mod
 	sce::Psr::BottomLevelBvhView bottomLevelBvhView{ sce::Psr::getBottomLevelBvhView(descriptor) };
 
 	// psr2my
-	m_primsCntOrig = idsCnt;
+	m_primsCntOrig = mesh.trisCnt;
 	m_primsCnt = 0;
 
 	m_nodesUsed = 1;
@@ -1156,6 +1294,287 @@ void BVH::buildPsr(Vector4* vts, INT vtsCnt, XMINT4* ids, INT idsCnt, Matrix mod
 	
 	m_nodes[0].leftCntPar.z = -2;
 	m_nodes[0] = m_nodes[0];
+
+	// psr reports max depth only
+	std::tie(m_depthMin, m_depthMax) = leafDepths();
+}
+
+namespace {
+	// 8 byte words chained through splitmix64 finalizer, so every bit of word reaches every bit of value
+	struct Hash64 {
+		uint64_t value{ 0xcbf29ce484222325ull };
+
+		static uint64_t mix(uint64_t x) {
+			x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+			x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+			return x ^ (x >> 31);
+		}
+
+		void add(const void* pData, size_t size) {
+			const uint8_t* bytes{ static_cast<const uint8_t*>(pData) };
+
+			size_t i{};
+			for (; i + 8 <= size; i += 8) {
+				uint64_t word{};
+				memcpy(&word, bytes + i, 8);
+				value = mix(value ^ word);
+			}
+			if (i < size) {
+				uint64_t word{};
+				memcpy(&word, bytes + i, size - i);
+				value = mix(value ^ word ^ (static_cast<uint64_t>(size - i) << 56));
+			}
+		}
+	};
+
+	uint64_t alignCache(uint64_t offset, uint64_t alignment) {
+		return (offset + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+std::pair<int, int> BVH::leafDepths() {
+	int depthMin{ m_nodesUsed ? std::numeric_limits<int>::max() : -1 };
+	int depthMax{ -1 };
+
+	std::stack<std::pair<int, int>> nodes{};
+	if (m_nodesUsed)
+		nodes.push({ 0, 0 });
+	while (!nodes.empty()) {
+		auto [nodeId, d] { nodes.top() };
+		nodes.pop();
+
+		const BVHNode& node{ m_nodes[nodeId] };
+		if (node.leftCntPar.y) {
+			depthMin = std::min(depthMin, d);
+			depthMax = std::max(depthMax, d);
+			continue;
+		}
+
+		int childsCnt{ isWide() ? node.leftCntPar.w : 2 };
+		for (int i{}; i < childsCnt; ++i)
+			nodes.push({ node.leftCntPar.x + i, d + 1 });
+	}
+
+	return { depthMin, depthMax };
+}
+
+// builders track depth in binary levels or not at all, so stats measure it on built tree
+BVH::BuildStats BVH::getBuildStats() {
+	auto [depthMin, depthMax] { leafDepths() };
+
+	return {
+		.sahCost{ m_sahCost },
+		.primsCnt{ m_primsCntOrig },
+		.nodesCnt{ m_nodesUsed },
+		.leafsCnt{ m_leafsCnt },
+		.isWide{ isWide() },
+		.depthMin{ depthMin },
+		.depthMax{ depthMax },
+		// refs duplicated by any splitting builder
+		.splitCnt{ static_cast<int>(m_primRefs.size()) - m_primsCntOrig },
+		.buildMemory{ m_buildMemory }
+	};
+}
+
+bool BVH::loadParams(const std::string& path) {
+	std::ifstream file{ path };
+	if (!file)
+		return false;
+
+	for (std::string line{}; std::getline(file, line);) {
+		std::istringstream stream{ line };
+		std::string name{};
+		if (!(stream >> name) || name[0] == '#')
+			continue;
+
+		forEachParam([&](const char* paramName, auto& value) {
+			if (name == paramName)
+				stream >> value;
+		});
+	}
+	return true;
+}
+
+bool BVH::saveParams(const std::string& path) {
+	std::ofstream file{ path };
+	forEachParam([&](const char* name, const auto& value) {
+		file << name << ' ' << value << '\n';
+	});
+	return static_cast<bool>(file);
+}
+
+uint64_t BVH::cacheKey(const MeshView& mesh, Matrix modelMatrix) {
+	Hash64 hash{};
+	hash.add(&CacheVersion, sizeof(CacheVersion));
+	hash.add(mesh.pVertices, mesh.verticesSize());
+	hash.add(&mesh.indexSize, sizeof(mesh.indexSize));
+	hash.add(mesh.pIndices, mesh.indicesSize());
+	hash.add(&modelMatrix, sizeof(Matrix));
+
+	forEachParam([&](const char* name, const auto& value) {
+		hash.add(name, strlen(name));
+		hash.add(&value, sizeof(value));
+	});
+
+	return hash.value;
+}
+
+bool BVH::loadCache(const std::string& path, uint64_t key, const MeshView& mesh) {
+	PROFILE_ZONE("loadCache");
+
+	MappedFile file{};
+	if (!file.open(path) || file.size() < sizeof(CacheHeader))
+		return false;
+
+	const CacheHeader& header{ *reinterpret_cast<const CacheHeader*>(file.data()) };
+	if (header.magic != CacheMagic || header.version != CacheVersion || header.key != key
+		|| header.trisCnt != mesh.trisCnt || header.verticesCnt != mesh.verticesCnt || header.primsCntOrig != mesh.trisCnt
+		|| header.nodesUsed < 1 || static_cast<uint32_t>(header.nodesUsed) > header.nodesCnt
+		|| (header.flatTrisCnt && header.flatTrisCnt < header.primRefsCnt)
+		|| header.nodesOffset + header.nodesCnt * sizeof(BVHNode) > file.size()
+		|| header.primRefsOffset + header.primRefsCnt * sizeof(PrimRef) > file.size()
+		|| header.flatTrisOffset + header.flatTrisCnt * sizeof(FlatTri) > file.size())
+		return false;
+
+	const BVHNode* pNodes{ reinterpret_cast<const BVHNode*>(file.data() + header.nodesOffset) };
+	const PrimRef* pPrimRefs{ reinterpret_cast<const PrimRef*>(file.data() + header.primRefsOffset) };
+	const FlatTri* pFlatTris{ reinterpret_cast<const FlatTri*>(file.data() + header.flatTrisOffset) };
+
+	// key may collide, so tree must not index past its own arrays or mesh
+	bool wide{ isWide() };
+	for (int i{}; i < header.nodesUsed; ++i) {
+		const XMINT4& lcp{ pNodes[i].leftCntPar };
+		int64_t end{ static_cast<int64_t>(lcp.x) + (lcp.y ? lcp.y : (wide ? lcp.w : 2)) };
+		if (lcp.x < 0 || lcp.y < 0 || end > (lcp.y ? static_cast<int64_t>(header.primRefsCnt) : header.nodesUsed))
+			return false;
+	}
+	for (uint32_t i{}; i < header.primRefsCnt; ++i) {
+		if (pPrimRefs[i].primId >= static_cast<unsigned>(mesh.trisCnt))
+			return false;
+	}
+
+	m_nodes.assign(pNodes, pNodes + header.nodesCnt);
+	m_primRefs.assign(pPrimRefs, pPrimRefs + header.primRefsCnt);
+	m_flatTris.assign(pFlatTris, pFlatTris + header.flatTrisCnt);
+
+	m_primsCntOrig = header.primsCntOrig;
+	m_primsCnt = header.primsCnt;
+	m_nodesUsed = header.nodesUsed;
+	m_leafsCnt = header.leafsCnt;
+	m_depthMin = header.depthMin;
+	m_depthMax = header.depthMax;
+	m_frmSize = header.frmSize;
+	m_clampedCnt = header.clampedCnt;
+	m_splitCnt = header.splitCnt;
+	m_clamp = header.clamp;
+	m_sahCost = header.sahCost;
+
+	return true;
+}
+
+bool BVH::saveCache(const std::string& path, uint64_t key, const MeshView& mesh) {
+	CacheHeader header{
+		.key{ key },
+		.nodesCnt{ static_cast<uint32_t>(m_nodes.size()) },
+		.primRefsCnt{ static_cast<uint32_t>(m_primRefs.size()) },
+		.flatTrisCnt{ static_cast<uint32_t>(m_flatTris.size()) },
+		.primsCntOrig{ m_primsCntOrig },
+		.primsCnt{ m_primsCnt },
+		.nodesUsed{ m_nodesUsed },
+		.leafsCnt{ m_leafsCnt },
+		.depthMin{ m_depthMin },
+		.depthMax{ m_depthMax },
+		.frmSize{ m_frmSize },
+		.clampedCnt{ m_clampedCnt },
+		.splitCnt{ m_splitCnt },
+		.clamp{ m_clamp },
+		.sahCost{ m_sahCost },
+		.trisCnt{ mesh.trisCnt },
+		.verticesCnt{ mesh.verticesCnt }
+	};
+	header.nodesOffset = alignCache(sizeof(CacheHeader), CacheAlignment);
+	header.primRefsOffset = alignCache(header.nodesOffset + sizeof(BVHNode) * m_nodes.size(), CacheAlignment);
+	header.flatTrisOffset = alignCache(header.primRefsOffset + sizeof(PrimRef) * m_primRefs.size(), CacheAlignment);
+
+	// written under temporary name so partial file is never loaded
+	std::string tmpPath{ path + ".tmp" };
+	{
+		std::ofstream file{ tmpPath, std::ios::binary };
+		if (!file)
+			return false;
+
+		const char zeros[CacheAlignment]{};
+		auto pad = [&](uint64_t offset) {
+			file.write(zeros, offset - static_cast<uint64_t>(file.tellp()));
+		};
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+		pad(header.nodesOffset);
+		file.write(reinterpret_cast<const char*>(m_nodes.data()), sizeof(BVHNode) * m_nodes.size());
+		pad(header.primRefsOffset);
+		file.write(reinterpret_cast<const char*>(m_primRefs.data()), sizeof(PrimRef) * m_primRefs.size());
+		pad(header.flatTrisOffset);
+		file.write(reinterpret_cast<const char*>(m_flatTris.data()), sizeof(FlatTri) * m_flatTris.size());
+
+		if (!file)
+			return false;
+	}
+
+	std::error_code ec{};
+	std::filesystem::rename(tmpPath, path, ec);
+	return !ec;
+}
+
+void BVH::evictCache(const std::string& dir) {
+	struct Entry {
+		std::filesystem::path path{};
+		uintmax_t size{};
+		std::filesystem::file_time_type time{};
+	};
+
+	std::error_code ec{};
+	std::vector<Entry> entries{};
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator{ dir, ec }) {
+		if (entry.path().extension() == ".bvh" && entry.is_regular_file(ec))
+			entries.push_back({ entry.path(), entry.file_size(ec), entry.last_write_time(ec) });
+	}
+
+	// newest first, so trees past size or age limit are at the end
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+		return a.time > b.time;
+	});
+
+	auto oldest{ std::filesystem::file_time_type::clock::now() - std::chrono::hours{ 24 * CacheDaysMax } };
+	uintmax_t total{};
+	for (const Entry& entry : entries) {
+		total += entry.size;
+		if (total > CacheBytesMax || entry.time < oldest)
+			std::filesystem::remove(entry.path, ec);
+	}
+}
+
+void BVH::buildFlatTris(const MeshView& mesh, Matrix modelMatrix) {
+	m_flatTris.resize(m_primRefs.size());
+
+	Parallel::forEach(0, m_nodesUsed, [&](int nodeId) {
+		const BVHNode& node{ m_nodes[nodeId] };
+
+		for (int i{ node.leftCntPar.x }; i < node.leftCntPar.x + node.leftCntPar.y; ++i) {
+			int primId{ static_cast<int>(m_primRefs[i].primId) };
+
+			XMUINT3 tri{ mesh.tri(primId) };
+			Vector4 v0{ Vector4::Transform(mesh.vertex(tri.x), modelMatrix) };
+			Vector4 v1{ Vector4::Transform(mesh.vertex(tri.y), modelMatrix) };
+			Vector4 v2{ Vector4::Transform(mesh.vertex(tri.z), modelMatrix) };
+
+			m_flatTris[i] = {
+				.v0{ v0.x, v0.y, v0.z },
+				.primId{ primId },
+				.e1{ v1.x - v0.x, v1.y - v0.y, v1.z - v0.z },
+				.e2{ v2.x - v0.x, v2.y - v0.y, v2.z - v0.z }
+			};
+		}
+	}, 256);
 }
 
 void BVH::binaryBVH2QBVH() {
@@ -1222,12 +1641,191 @@ void BVH::binaryBVH2QBVH() {
 		}
 	}
 
-	m_nodes = newNodes;
+	m_nodes = std::move(newNodes);
 	m_nodesUsed = newNodesUsed;
 	m_nodes[0].leftCntPar.z = -2;
 }
 
+void BVH::reorderNodes(const std::vector<unsigned>& visits) {
+	bool wide{ isWide() };
+	auto childsCnt = [&](int n) {
+		return m_nodes[n].leftCntPar.y ? 0 : (wide ? m_nodes[n].leftCntPar.w : 2);
+	};
+
+	// visit probability: measured visits if given, surface area otherwise
+	bool isVisits{ m_algLayout == 3 && visits.size() >= static_cast<size_t>(m_nodesUsed) };
+	auto weight = [&](int n) {
+		return isVisits ? static_cast<float>(visits[n]) : m_nodes[n].bb.area();
+	};
+
+	// old id -> new id and back, sibling groups are placed together
+	std::vector<int> newIds(m_nodesUsed, -1);
+	std::vector<int> order{ 0 };
+	order.reserve(m_nodesUsed);
+	newIds[0] = 0;
+
+	auto placeChilds = [&](int n) {
+		for (int i{}; i < childsCnt(n); ++i) {
+			newIds[m_nodes[n].leftCntPar.x + i] = static_cast<int>(order.size());
+			order.push_back(m_nodes[n].leftCntPar.x + i);
+		}
+	};
+
+	if (m_algLayout == 1) {
+		// subtree sizes, children are always allocated after parents
+		std::vector<int> sizes(m_nodesUsed, 1);
+		std::vector<int> pre{};
+		pre.reserve(m_nodesUsed);
+
+		std::stack<int> nodes{};
+		nodes.push(0);
+		while (!nodes.empty()) {
+			int n{ nodes.top() };
+			nodes.pop();
+			pre.push_back(n);
+			for (int i{}; i < childsCnt(n); ++i)
+				nodes.push(m_nodes[n].leftCntPar.x + i);
+		}
+		for (auto it{ pre.rbegin() }; it != pre.rend(); ++it) {
+			if (*it)
+				sizes[m_nodes[*it].leftCntPar.z] += sizes[*it];
+		}
+
+		nodes.push(0);
+		while (!nodes.empty()) {
+			int n{ nodes.top() };
+			nodes.pop();
+			if (!childsCnt(n))
+				continue;
+
+			placeChilds(n);
+
+			// larger child on top to be descended first
+			int childs[4]{};
+			int cnt{ childsCnt(n) };
+			for (int i{}; i < cnt; ++i)
+				childs[i] = m_nodes[n].leftCntPar.x + i;
+			std::sort(childs, childs + cnt, [&](int a, int b) { return sizes[a] < sizes[b]; });
+			for (int i{}; i < cnt; ++i)
+				nodes.push(childs[i]);
+		}
+	}
+	else {
+		// treelets of most probable nodes, each fits m_layoutTreeletLines cache lines
+		size_t treeletSize{ std::max<size_t>(2, m_layoutTreeletLines * 64 / sizeof(BVHNode)) };
+
+		std::stack<int> roots{};
+		roots.push(0);
+		while (!roots.empty()) {
+			int root{ roots.top() };
+			roots.pop();
+
+			std::priority_queue<std::pair<float, int>> cands{};
+			cands.push({ weight(root), root });
+
+			size_t size{};
+			while (!cands.empty()) {
+				int n{ cands.top().second };
+				if (size && size + childsCnt(n) > treeletSize)
+					break;
+				cands.pop();
+
+				placeChilds(n);
+				size += childsCnt(n);
+
+				for (int i{}; i < childsCnt(n); ++i) {
+					int child{ m_nodes[n].leftCntPar.x + i };
+					if (childsCnt(child))
+						cands.push({ weight(child), child });
+				}
+			}
+
+			// rest start new treelets, most probable first
+			std::vector<std::pair<float, int>> rest{};
+			for (; !cands.empty(); cands.pop())
+				rest.push_back(cands.top());
+			for (auto it{ rest.rbegin() }; it != rest.rend(); ++it)
+				roots.push(it->second);
+		}
+	}
+
+	std::vector<BVHNode> newNodes(order.size());
+	std::vector<PrimRef> newPrimRefs{ m_primRefs };
+	std::vector<FlatTri> newFlatTris{ m_flatTris };
+	int primsUsed{};
+
+	for (int i{}; i < static_cast<int>(order.size()); ++i) {
+		BVHNode& node{ newNodes[i] };
+		node = m_nodes[order[i]];
+
+		if (node.leftCntPar.z >= 0)
+			node.leftCntPar.z = newIds[node.leftCntPar.z];
+
+		if (!node.leftCntPar.y) {
+			node.leftCntPar.x = newIds[node.leftCntPar.x];
+			continue;
+		}
+
+		// prim refs follow leafs order
+		std::copy_n(m_primRefs.begin() + node.leftCntPar.x, node.leftCntPar.y, newPrimRefs.begin() + primsUsed);
+		if (!m_flatTris.empty())
+			std::copy_n(m_flatTris.begin() + node.leftCntPar.x, node.leftCntPar.y, newFlatTris.begin() + primsUsed);
+		node.leftCntPar.x = primsUsed;
+		primsUsed += node.leftCntPar.y;
+	}
+
+	m_nodes = std::move(newNodes);
+	m_nodesUsed = static_cast<int>(order.size());
+	m_primRefs = std::move(newPrimRefs);
+	m_flatTris = std::move(newFlatTris);
+}
+
+namespace {
+	// floor(log(x) / log(base)), read from float exponent bits when base is 2^k or 2^(1/k)
+	struct FloorLog {
+		float logBase{};
+		int mul{ 1 };
+		int div{};
+		float steps[7]{};
+
+		FloorLog(float base) : logBase{ std::log(base) } {
+			float log2Base{ std::log2(base) };
+			if (log2Base >= 1.f && std::abs(log2Base - std::round(log2Base)) < 1e-4f) {
+				div = static_cast<int>(std::round(log2Base));
+			}
+			else if (0.f < log2Base && log2Base < 1.f) {
+				float inv{ 1.f / log2Base };
+				if (std::round(inv) <= 8.f && std::abs(inv - std::round(inv)) < 1e-3f) {
+					mul = static_cast<int>(std::round(inv));
+					div = 1;
+					for (int j{ 1 }; j < mul; ++j)
+						steps[j - 1] = std::exp2(static_cast<float>(j) / mul);
+				}
+			}
+		}
+
+		float operator()(float x) const {
+			uint32_t bits{ std::bit_cast<uint32_t>(x) };
+			// sign bit lands in exponent, so negatives go to log too, as zeros, denormals and nans do
+			uint32_t exponent{ bits >> 23 };
+			if (!div || !exponent || exponent >= 255)
+				return std::floor(std::log(x) / logBase);
+
+			// mul * log2(x) rounded down is mul * exponent plus steps mantissa reaches
+			float mantissa{ std::bit_cast<float>((bits & 0x7fffffu) | 0x3f800000u) };
+			int l{ (static_cast<int>(exponent) - 127) * mul };
+			for (int j{}; j < mul - 1 && steps[j] <= mantissa; ++j)
+				++l;
+
+			return static_cast<float>(l >= 0 ? l / div : -((div - 1 - l) / div));
+		}
+	};
+}
+
 void BVH::buildStochastic() {
+	PROFILE_ZONE("buildStochastic");
+	PROFILE_PHASE(phase, "morton codes");
+
 	auto it = m_primRefs.begin();
 	// compute morton indices of primitives
 	for (int i{}; i < m_primsCnt; ++i) {
@@ -1235,6 +1833,7 @@ void BVH::buildStochastic() {
 	}
 
 	// sort primitives
+	PROFILE_NEXT(phase, "sort");
 	std::sort(
 		m_primRefs.begin(),
 		m_primRefs.end(),
@@ -1244,34 +1843,62 @@ void BVH::buildStochastic() {
 	);
 
 	// init weights
+	PROFILE_NEXT(phase, "cdf & clamping");
 	std::vector<float> cdf(m_primsCnt);
+
+	// prims are processed in fixed chunks, so sums do not depend on threads count
+	constexpr int chunkSize{ 4096 };
+	int chunksCnt{ (m_primsCnt + chunkSize - 1) / chunkSize };
+
+	struct Chunk {
+		float sum{};
+		float wmin{ std::numeric_limits<float>::max() };
+		float wmax{ std::numeric_limits<float>::lowest() };
+		int clampedCnt{};
+		int splitCnt{};
+		int hMin{};
+		std::vector<int> binCnts{};
+	};
+	std::vector<Chunk> chunks(chunksCnt);
+
+	// cdf init and weight clamping histogram building (alg 1)
+	FloorLog floorLog{ m_clampBase };
+	Parallel::forEach(0, chunksCnt, [&](int c) {
+		Chunk& chunk{ chunks[c] };
+		chunk.binCnts.resize(m_clampBinCnt);
+
+		int last{ std::min<int>(m_primsCnt, (c + 1) * chunkSize) };
+		for (int i{ c * chunkSize }; i < last; ++i) {
+			chunk.sum += (cdf[i] = m_prims[m_primRefs[i].primId].bb.area());
+			chunk.wmin = std::min<float>(chunk.wmin, cdf[i]);
+			chunk.wmax = std::max<float>(chunk.wmax, cdf[i]);
+
+			++chunk.binCnts[static_cast<size_t>(std::min<float>(
+				std::max<float>(m_clampOffset + floorLog(cdf[i]), 0.f),
+				m_clampBinCnt - 1.f
+			))];
+		}
+	});
+
 	float sum{};
 	float wmin{ std::numeric_limits<float>::max() };
 	float wmax{ std::numeric_limits<float>::lowest() };
 
 	// algorithm 1: histogram weight clamping
 	std::vector<int> bin_cnts(m_clampBinCnt);
-
-	// cdf init and weight clamping histogram building (alg 1)
-	it = m_primRefs.begin();
-	for (int i{}; i < m_primsCnt; ++i) {
-		sum += (cdf[i] = m_prims[(*(it++)).primId].bb.area());
-		wmin = std::min<float>(wmin, cdf[i]);
-		wmax = std::max<float>(wmax, cdf[i]);
-
-		++bin_cnts[static_cast<size_t>(std::min<float>(
-			std::max<float>(
-				m_clampOffset + std::floor(std::log(cdf[i]) / std::log(m_clampBase)),
-				0.f
-			),
-			m_clampBinCnt - 1.f
-		))];
+	for (const Chunk& chunk : chunks) {
+		sum += chunk.sum;
+		wmin = std::min<float>(wmin, chunk.wmin);
+		wmax = std::max<float>(wmax, chunk.wmax);
+		for (int b{}; b < m_clampBinCnt; ++b)
+			bin_cnts[b] += chunk.binCnts[b];
 	}
 
 	m_primWeightMin = wmin;
 	m_primWeightMax = wmax;
 
-	std::vector<bool> isSplit(m_primsCnt);
+	// bytes, threads mark prims concurrently
+	std::vector<uint8_t> isSplit(m_primsCnt);
 	m_splitCnt = 0;
 
 	{
@@ -1307,21 +1934,33 @@ void BVH::buildStochastic() {
 		// reweighting if found
 		m_clampedCnt = 0;
 		if (clamp != std::numeric_limits<float>::max()) {
-			sum = 0.f;
-			for (int i{}; i < m_primsCnt; ++i) {
-				if (clamp < cdf[i]) {
-					cdf[i] = clamp;
-					++m_clampedCnt;
-					if (m_primSplitting == 1) {
+			Parallel::forEach(0, chunksCnt, [&](int c) {
+				Chunk& chunk{ chunks[c] };
+				chunk.sum = 0.f;
+
+				int last{ std::min<int>(m_primsCnt, (c + 1) * chunkSize) };
+				for (int i{ c * chunkSize }; i < last; ++i) {
+					if (clamp < cdf[i]) {
+						cdf[i] = clamp;
+						++chunk.clampedCnt;
+						if (m_primSplitting == 1) {
+							isSplit[m_primRefs[i].primId] = true;
+							++chunk.splitCnt;
+						}
+					}
+					else if (m_primSplitting > 1 && clamp0 < cdf[i]) {
 						isSplit[m_primRefs[i].primId] = true;
-						++m_splitCnt;
+						++chunk.splitCnt;
 					}
+					chunk.sum += cdf[i];
 				}
-				else if (m_primSplitting > 1 && clamp0 < cdf[i]) {
-					isSplit[m_primRefs[i].primId] = true;
-					++m_splitCnt;
-				}
-				sum += cdf[i];
+			});
+
+			sum = 0.f;
+			for (const Chunk& chunk : chunks) {
+				sum += chunk.sum;
+				m_clampedCnt += chunk.clampedCnt;
+				m_splitCnt += chunk.splitCnt;
 			}
 		}
 		else {
@@ -1330,33 +1969,95 @@ void BVH::buildStochastic() {
 	}
 
 	// reweighting with uniform dist & calc cdf
-	cdf[0] = cdf[0] * (1.f - m_uniform) + sum * m_uniform / m_primsCnt;
-	for (int i{ 1 }; i < m_primsCnt; ++i) {
-		cdf[i] = cdf[i - 1] + cdf[i] * (1.f - m_uniform) + sum * m_uniform / m_primsCnt;
-	}
+	// chunks are scanned locally, then shifted by the sum of previous chunk ends, which keeps cdf monotonic
+	float uniformPart{ sum * m_uniform / m_primsCnt };
+	Parallel::forEach(0, chunksCnt, [&](int c) {
+		int last{ std::min<int>(m_primsCnt, (c + 1) * chunkSize) };
+
+		float acc{};
+		for (int i{ c * chunkSize }; i < last; ++i)
+			cdf[i] = (acc += cdf[i] * (1.f - m_uniform) + uniformPart);
+	});
+
+	std::vector<float> chunkOffsets(chunksCnt);
+	for (int c{ 1 }; c < chunksCnt; ++c)
+		chunkOffsets[c] = chunkOffsets[c - 1] + cdf[c * chunkSize - 1];
+
+	Parallel::forEach(1, chunksCnt, [&](int c) {
+		int last{ std::min<int>(m_primsCnt, (c + 1) * chunkSize) };
+		for (int i{ c * chunkSize }; i < last; ++i)
+			cdf[i] += chunkOffsets[c];
+	});
 	sum = cdf[m_primsCnt - 1];
 
 	// selecting for carcass
-	int frmSize{}, frmExpSize{ static_cast<int>(std::round(m_primsCnt * m_frmPart)) };
-	float prob{ 1.f * (1.f * frmSize) / frmExpSize };
-	it = m_edge = m_primRefs.begin();
-	for (int i{}; i < m_primsCnt; ++i) {
-		if (frmSize == frmExpSize || cdf[i] <= prob * sum) {
-			(*(it++)).subsetNearest = frmSize - 1;
-			continue;
+	PROFILE_NEXT(phase, "subset selection");
+	// prim i is taken while frame is not full and cdf[i] > frmSize / frmExpSize * sum, so
+	// frmSize after i is min(frmExpSize, i + min(1, min over j <= i of c[j] - j)),
+	// c[j] being the least frmSize whose threshold is not below cdf[j]
+	int frmExpSize{ static_cast<int>(std::round(m_primsCnt * m_frmPart)) };
+	std::vector<int> cMinusI(m_primsCnt);
+
+	auto threshold = [&](int frmSize) {
+		return 1.f * (1.f * frmSize) / frmExpSize * sum;
+	};
+
+	Parallel::forEach(0, chunksCnt, [&](int c) {
+		int first{ c * chunkSize };
+		int last{ std::min<int>(m_primsCnt, first + chunkSize) };
+
+		int hMin{ std::numeric_limits<int>::max() };
+		for (int i{ first }; i < last; ++i) {
+			// estimate, then fix float rounding against the exact threshold
+			float q{ cdf[i] / sum * frmExpSize };
+			int need{ q > 0.f ? static_cast<int>(std::min<float>(std::ceil(q), frmExpSize + 1.f)) : 0 };
+			while (need > 0 && cdf[i] <= threshold(need - 1))
+				--need;
+			while (need <= frmExpSize && cdf[i] > threshold(need))
+				++need;
+
+			hMin = std::min<int>(hMin, cMinusI[i] = need - i);
 		}
+		chunks[c].hMin = hMin;
+	});
 
-		(*it).subsetNearest = frmSize++;
-		prob = 1.f * frmSize / frmExpSize;
+	// running min carried into chunks
+	std::vector<int> hCarry(chunksCnt);
+	for (int c{}, h{ 1 }; c < chunksCnt; ++c) {
+		hCarry[c] = h;
+		h = std::min<int>(h, chunks[c].hMin);
+	}
+	int frmSize{ std::min<int>(frmExpSize, m_primsCnt - 1 + std::min<int>(hCarry[chunksCnt - 1], chunks[chunksCnt - 1].hMin)) };
+
+	// stable partition, both subset and rest stay in morton order
+	std::vector<PrimRef> subset(frmSize);
+	std::vector<PrimRef> notSubset(m_primsCnt - frmSize);
+	Parallel::forEach(0, chunksCnt, [&](int c) {
+		int first{ c * chunkSize };
+		int last{ std::min<int>(m_primsCnt, first + chunkSize) };
+
+		int h{ hCarry[c] };
+		int sizePrev{ std::min<int>(frmExpSize, first - 1 + h) };
+		for (int i{ first }; i < last; ++i) {
+			h = std::min<int>(h, cMinusI[i]);
+			int size{ std::min<int>(frmExpSize, i + h) };
+
+			PrimRef& ref{ m_primRefs[i] };
+			ref.subsetNearest = size - 1;
+			if (size > sizePrev)
+				subset[size - 1] = ref;
+			else
+				notSubset[i - size] = ref;
 
-		std::swap(*it++, *m_edge++);
-	}
+			sizePrev = size;
+		}
+	});
 
-	std::vector<PrimRef> notSubset(m_edge, m_primRefs.end());
 	m_edge = notSubset.begin();
-	m_primRefs.resize(frmSize);
+	m_primRefs = std::move(subset);
 
 	// build frame
+	PROFILE_NEXT(phase, "frame build");
 	BVHNode& root = m_nodes[0];
 	root.leftCntPar = { 0, frmSize, -1, 0 };
 	updateNodeBoundsStoh(0);
@@ -1411,6 +2112,7 @@ void BVH::buildStochastic() {
 	}
 	m_frmSize = m_primRefs.size();
 
+	PROFILE_NEXT(phase, "insertion");
 	int notFrmSize = notSubset.size();
 	for (int j{}; j < frmSize; ++j) {
 		for (int i{ j }; i < notFrmSize; i += frmSize) {
@@ -1609,6 +2311,7 @@ void BVH::buildStochastic() {
 		}
 	}
 
+	PROFILE_NEXT(phase, "leaf subdivision");
 	m_leafsCnt = 0;
 	int firstOffset{}, nextCnt{}, lastNodeId{};
 	if (m_algNotSubsetBuild == 1)
@@ -1654,6 +2357,7 @@ void BVH::buildStochastic() {
 		lastNodeId = nodeId;
 	});
 
+	PROFILE_NEXT(phase, "finalisation");
 	if (m_algNotSubsetBuild == 1) {
 		std::vector<PrimRef> temp = m_primRefs;
 		size_t id{};
@@ -1674,16 +2378,16 @@ void BVH::buildStochastic() {
 				++id;
 			}
 			m_nodes[nodeId].leftCntPar.x = newLeft;
+			m_nodes[nodeId].leftCntPar.y = static_cast<int>(id) - newLeft;
 		});
+		m_primRefs.resize(id);
+	}
+	else {
+		// refs to split offcuts point to their source triangle
+		for (PrimRef& ref : m_primRefs)
+			ref.primId = m_prims[ref.primId].primId;
 	}
 
-	//for (int i{}; i < m_primRefs.size(); ++i) {
-	//	int primId{ m_prims[m_primRefs[i].primId].primId};
-	//	if (m_primRefs[i].primId != primId) {
-	//		m_primRefs[i].primId = primId;
-	//	}
-	//}
-	
 	m_primsCnt = m_primRefs.size();
 	m_nodes[0] = m_nodes[0];
 }
@@ -1696,10 +2400,10 @@ float BVH::primInsertMetric(int primId, int nodeId) {
 	if (m_algInsertConds == 1 || m_algInsertConds == 3)
 		leafPrimsCnt += node.leftCntPar.w;
 
-	float cost{
+	float cost{ m_costIntersect * (
 		(leafPrimsCnt + 1) * AABB::bbUnion(node.bb, prim.bb).area()
 			- (leafPrimsCnt) * node.bb.area()
-	};
+	) };
 	if (node.leftCntPar.z != -1) // TODO check prev cost
 	do {
 		node = m_nodes[node.leftCntPar.z];
@@ -1707,7 +2411,7 @@ float BVH::primInsertMetric(int primId, int nodeId) {
 		float area{ node.bb.area() };
 		if (newArea - area < std::numeric_limits<float>::epsilon())
 			break;
-		cost += newArea - area;
+		cost += costNode() * (newArea - area);
 	} while (node.leftCntPar.z != -1);
 
 	return cost;
@@ -1769,7 +2473,7 @@ int BVH::findBestLeafSmartBVH(int primId, int frmNearest) {
 	};
 	std::priority_queue<std::pair<int, float>, std::vector<std::pair<int, float>>, decltype(cmp)> nodes(cmp);
 
-	nodes.push({0, AABB::bbUnion(m_nodes[0].bb, prim.bb).area() - m_nodes[0].bb.area()});
+	nodes.push({ 0, costNode() * (AABB::bbUnion(m_nodes[0].bb, prim.bb).area() - m_nodes[0].bb.area()) });
 
 	while (!nodes.empty()) {
 		auto nodeCost = nodes.top();
@@ -1795,14 +2499,14 @@ int BVH::findBestLeafSmartBVH(int primId, int frmNearest) {
 		if (m_algInsertConds == 1 || m_algInsertConds == 3)
 			lCnt += m_nodes[l].leftCntPar.w;
 		if (lCnt) {
-			lCost += (lCnt + 1) * AABB::bbUnion(m_nodes[l].bb, prim.bb).area() - lCnt * m_nodes[l].bb.area();
+			lCost += m_costIntersect * ((lCnt + 1) * AABB::bbUnion(m_nodes[l].bb, prim.bb).area() - lCnt * m_nodes[l].bb.area());
 			if (lCost <= bestCost + std::numeric_limits<float>::epsilon()) {
 				bestLeaf = l;
 				bestCost = lCost;
 			}
 		}
 		else {
-			lCost += AABB::bbUnion(m_nodes[l].bb, prim.bb).area() - m_nodes[l].bb.area();
+			lCost += costNode() * (AABB::bbUnion(m_nodes[l].bb, prim.bb).area() - m_nodes[l].bb.area());
 			if (lCost <= bestCost + std::numeric_limits<float>::epsilon())
 				nodes.push({ l, lCost });
 		}
@@ -1814,14 +2518,14 @@ int BVH::findBestLeafSmartBVH(int primId, int frmNearest) {
 		if (m_algInsertConds == 1 || m_algInsertConds == 3)
 			rCnt += m_nodes[r].leftCntPar.w;
 		if (rCnt) {
-			rCost += (rCnt + 1) * AABB::bbUnion(m_nodes[r].bb, prim.bb).area() - rCnt * m_nodes[r].bb.area();
+			rCost += m_costIntersect * ((rCnt + 1) * AABB::bbUnion(m_nodes[r].bb, prim.bb).area() - rCnt * m_nodes[r].bb.area());
 			if (rCost <= bestCost + std::numeric_limits<float>::epsilon()) {
 				bestLeaf = r;
 				bestCost = rCost;
 			}
 		}
 		else {
-			rCost += AABB::bbUnion(m_nodes[r].bb, prim.bb).area() - m_nodes[r].bb.area();
+			rCost += costNode() * (AABB::bbUnion(m_nodes[r].bb, prim.bb).area() - m_nodes[r].bb.area());
 			if (rCost <= bestCost + std::numeric_limits<float>::epsilon()) 
 				nodes.push({ r, rCost });
 		}
@@ -1838,6 +2542,7 @@ void BVH::subdivideStohIntelQueue(int rootId) {
 		int nodeId{ nodes.front() };
 		nodes.pop();
 
+		reserveNodes(2);
 		BVHNode& node{ m_nodes[nodeId] };
 		updateNodeBounds(nodeId);
 
@@ -1920,7 +2625,7 @@ void BVH::subdivideStohIntelQueue(int rootId) {
 					binsCosts[a][i] = std::numeric_limits<float>::max();
 					continue;
 				}
-				binsCosts[a][i] = 1 + (cnt0 * b0.area() + cnt1 * b1.area()) / node.bb.area();
+				binsCosts[a][i] = costSplit(node.bb.area(), cnt0, b0.area(), cnt1, b1.area());
 			}
 		}
 
@@ -1941,7 +2646,7 @@ void BVH::subdivideStohIntelQueue(int rootId) {
 		assert(minCost != std::numeric_limits<float>::max());
 
 		// either create leaf or split prims at selected
-		float leafCost{ static_cast<float>(nPrims) };
+		float leafCost{ costLeaf(static_cast<float>(nPrims)) };
 		if (nPrims > m_primsPerLeaf /*max prims per leaf*/ || minCost < leafCost) {
 			PrimRef* pmid = std::partition(
 				&m_primRefs[node.leftCntPar.x],
@@ -1996,6 +2701,7 @@ void BVH::subdivideSBVHStohQueue(int rootId, bool swapPrimIdOnly, std::function<
 		int nodeId{ nodes.front() };
 		nodes.pop();
 
+		reserveNodes(2);
 		BVHNode& node{ m_nodes[nodeId] };
 
 		if (node.leftCntPar.y <= m_primsPerLeaf) {
@@ -2033,7 +2739,7 @@ void BVH::subdivideSBVHStohQueue(int rootId, bool swapPrimIdOnly, std::function<
 			int axis{ axisBin }, lCnt{}, rCnt{};
 			float splitPos{ splitPosBin };
 
-			if (costBinned >= node.leftCntPar.y)
+			if (costBinned >= costLeaf(static_cast<float>(node.leftCntPar.y)))
 			{
 				leafProc(nodeId);
 				continue;
@@ -2086,7 +2792,7 @@ void BVH::subdivideSBVHStohQueue(int rootId, bool swapPrimIdOnly, std::function<
 			int axis{ axisSBVH }, lCnt{}, rCnt{};
 			float splitPos{ splitPosSBVH };
 
-			if (costSBVH >= node.leftCntPar.y || m_primRefs.size() == 2 * m_primsCntOrig) {
+			if (costSBVH >= costLeaf(static_cast<float>(node.leftCntPar.y)) || m_primRefs.size() == 2 * m_primsCntOrig) {
 				leafProc(nodeId);
 				continue;
 			}
@@ -2224,6 +2930,7 @@ void BVH::subdivideStohQueue(INT rootId, bool swapPrimIdOnly, std::function<void
 		int nodeId{ nodes.front()};
 		nodes.pop();
 
+		reserveNodes(2);
 		BVHNode& node{ m_nodes[nodeId] };
 
 		if (node.leftCntPar.y <= m_primsPerLeaf) {
@@ -2245,7 +2952,7 @@ void BVH::subdivideStohQueue(INT rootId, bool swapPrimIdOnly, std::function<void
 		//}
 
 		//if (m_algBuild != 0 && cost >= node.bb.area() * node.leftCntPar.y) {
-		if (m_algBuild != 0 && cost >= node.leftCntPar.y) {
+		if (m_algBuild != 0 && cost >= costLeaf(static_cast<float>(node.leftCntPar.y))) {
 			leafProc(nodeId);
 			continue;
 		}
@@ -2347,7 +3054,7 @@ float BVH::splitBinnedSAHStoh4SBVH(BVHNode& node, int& axis, float& splitPos, AA
 		step = (bmax - bmin) / m_sahSteps;
 		for (int i{}; i < m_sahSteps - 1; ++i) {
 			//float planeCost{ lCnt[i] * lArea[i] + rCnt[i] * rArea[i] };
-			float planeCost{ 1.f + (lCnt[i] * lArea[i] + rCnt[i] * rArea[i]) / node.bb.area() };
+			float planeCost{ costSplit(node.bb.area(), lCnt[i], lArea[i], rCnt[i], rArea[i]) };
 			if (planeCost < bestCost) {
 				axis = a;
 				splitPos = bmin + (i + 1) * step;
@@ -2410,7 +3117,7 @@ float BVH::splitBinnedSAHStoh(BVHNode& node, int& axis, float& splitPos, AABB& l
 		step = (bmax - bmin) / m_sahSteps;
 		for (int i{}; i < m_sahSteps - 1; ++i) {
 			//float planeCost{ lCnt[i] * lArea[i] + rCnt[i] * rArea[i] };
-			float planeCost{ 1.f + (lCnt[i] * lArea[i] + rCnt[i] * rArea[i]) / node.bb.area() };
+			float planeCost{ costSplit(node.bb.area(), lCnt[i], lArea[i], rCnt[i], rArea[i]) };
 			if (planeCost < bestCost) {
 				axis = a;
 				splitPos = bmin + (i + 1) * step;
@@ -2493,7 +3200,7 @@ float BVH::splitSBVH(BVHNode& node, int& axis, float& splitPos, AABB& leftBb, in
 			lCnt += bins[dim][i - 1].enter;
 			rCnt -= bins[dim][i - 1].exit;
 
-			float currCost = 1.f + (lCnt * left.area() + rCnt * rest[i - 1].area()) / node.bb.area();
+			float currCost = costSplit(node.bb.area(), lCnt, left.area(), rCnt, rest[i - 1].area());
 			if (currCost < bestCost) {
 				axis = dim;
 				splitPos = bmin + i * step;
@@ -2832,6 +3539,7 @@ float BVH::splitBinnedSAH(BVHNode& node, int& axis, float& splitPos) {
 }
 
 void BVH::subdivide(INT nodeId) {
+	reserveNodes(2);
 	BVHNode& node{ m_nodes[nodeId] };
 
 	// determine split axis and position
@@ -2859,7 +3567,8 @@ void BVH::subdivide(INT nodeId) {
 		break;
 	}
 
-	if (m_algBuild != 0 && cost >= node.bb.area() * node.leftCntPar.y) {
+	// cost is not normalized by node area here
+	if (m_algBuild != 0 && costNode() + m_costIntersect * cost / node.bb.area() >= costLeaf(static_cast<float>(node.leftCntPar.y))) {
 		++m_leafsCnt;
 		updateDepths(nodeId);
 		return;
@@ -2931,13 +3640,13 @@ float BVH::costSAH(int nodeId) {
 	if (m_algBuild != 5 && !m_toQBVH) {
 		postForEach(nodeId, [&](int n) {
 			BVHNode& node{ m_nodes[n] };
-			cost += node.bb.area() * std::max<int>(1, node.leftCntPar.y);
+			cost += node.bb.area() * (node.leftCntPar.y ? costLeaf(static_cast<float>(node.leftCntPar.y)) : m_costTraversal);
 		});
 	}
 	else {
 		preForEachQuad(nodeId, [&](int n) {
 			BVHNode& node{ m_nodes[n] };
-			cost += node.bb.area() * std::max<int>(1, node.leftCntPar.y);
+			cost += node.bb.area() * (node.leftCntPar.y ? costLeaf(static_cast<float>(node.leftCntPar.y)) : m_costTraversalWide);
 		});
 	}
 	return static_cast<float>(cost / m_nodes[nodeId].bb.area());
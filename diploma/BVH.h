@@ -3,7 +3,9 @@
 #include "framework.h"
 
 #include "AABB.h"
+#include "MeshView.h"
 #include <algorithm>
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <stack>
@@ -24,6 +26,10 @@ using namespace DirectX::SimpleMath;
 #define MaxSteps 32
 
 class BVH {
+	friend class CPUTracer;
+	// headless micro benchmarks call private kernels
+	friend class KernelBench;
+
 	// ---------------
 	//	GRAPHICS PART
 	// ---------------
@@ -48,6 +54,19 @@ class BVH {
 	ID3D11Buffer* m_pPrimIdsBuffer{};
 	ID3D11ShaderResourceView* m_pPrimIdsBufferSRV{};
 
+	ID3D11Buffer* m_pFlatTrisBuffer{};
+	ID3D11ShaderResourceView* m_pFlatTrisBufferSRV{};
+
+	ID3D11Buffer* m_pPrimHighlightsBuffer{};
+	ID3D11ShaderResourceView* m_pPrimHighlightsBufferSRV{};
+
+	// elements buffers were created for
+	UINT m_bvhBufferCapacity{};
+	UINT m_primIdsBufferCapacity{};
+	UINT m_flatTrisBufferCapacity{};
+	UINT m_primHighlightsBufferCapacity{};
+	UINT m_modelBufferCapacity{};
+
 	ID3D11VertexShader* m_pVertexShader{};
 	ID3D11PixelShader* m_pPixelShader{};
 	ID3D11InputLayout* m_pInputLayout{};
@@ -81,6 +100,18 @@ public:
 		return m_pBVHBufferSRV;
 	}
 
+	ID3D11ShaderResourceView* getFlatTrisBufferSRV() {
+		return m_pFlatTrisBufferSRV;
+	}
+
+	ID3D11ShaderResourceView* getPrimHighlightsBufferSRV() {
+		return m_pPrimHighlightsBufferSRV;
+	}
+
+	bool isPrimHighlights() {
+		return m_aabbHighlightPrims || m_aabbHighlightAllPrims;
+	}
+
 	void updateRenderBVH();
 	void updateBuffers();
 
@@ -88,6 +119,16 @@ public:
 	void renderAABBsImGui();
 
 private:
+	// recreates buffer with geometric growth if cnt elements do not fit
+	void reserveBuffer(
+		ID3D11Buffer** ppBuffer,
+		ID3D11ShaderResourceView** ppSRV,
+		UINT& capacity,
+		UINT stride,
+		UINT cnt,
+		const std::string& name
+	);
+
 	// ------------
 	//	LOGIC PART
 	// ------------
@@ -112,23 +153,39 @@ private:
 	};
 	std::vector<BVHNode> m_nodes{};
 
+	// only primId is uploaded, rest is build scratch
 	struct PrimRef {
 		unsigned primId;
 		union {
 			unsigned mortonCode;
 			unsigned next;
 		};
-		union {
-			unsigned subsetNearest;
-			unsigned isAABBHighlight;
-		};
-		union {
-			unsigned leafId;
-			unsigned isSplitHighlight;
-		};
+		unsigned subsetNearest;
+		unsigned leafId;
 	};
 
 	std::vector<PrimRef> m_primRefs{};
+
+	// 2 bits per prim by prim id, uploaded only while prims are highlighted
+	static constexpr uint32_t PrimHighlightAABB{ 1 };
+	static constexpr uint32_t PrimHighlightSplit{ 2 };
+	std::vector<uint32_t> m_primHighlights{};
+
+	void highlightPrim(unsigned primId, uint32_t flags) {
+		m_primHighlights[primId / 16] |= flags << (primId % 16 * 2);
+	}
+
+	// world space triangles in prim refs order, ready for Moller-Trumbore
+	struct FlatTri {
+		Vector3 v0{};
+		int primId{};
+		Vector3 e1{};
+		int pad0{};
+		Vector3 e2{};
+		int pad1{};
+	};
+	std::vector<FlatTri> m_flatTris{};
+
 	std::map<unsigned, std::vector<unsigned>> m_subset2leafs{};
 	
 	std::vector<PrimRef>::iterator m_edge{};
@@ -154,6 +211,12 @@ private:
 	INT m_algBuild{ 4 };
 	INT m_primsPerLeaf{ 2 };
 	INT m_sahSteps{ 32 };
+
+	// sah costs of binary node visit, 4 wide node visit and triangle test,
+	// nominal by default, headless calibrate measures them with CPUTracer
+	float m_costTraversal{ 1.f };
+	float m_costTraversalWide{ 1.f };
+	float m_costIntersect{ 1.f };
 	// 0 - bruteforce
 	// 1 - morton
 	// 2 - smart bvh
@@ -184,6 +247,15 @@ private:
 
 	bool m_toQBVH{ true };
 
+	// 0 - as built
+	// 1 - dfs, larger child first
+	// 2 - treelets by surface area
+	// 3 - treelets by visit frequency
+	int m_algLayout{ 1 };
+	int m_layoutTreeletLines{ 8 };
+
+	bool m_flatTrisOn{ true };
+
 	// 0 - no prims splitting
 	// 1 - subset splitting before clustering
 	// 2 - prev clamp hist interval (naive)
@@ -208,13 +280,142 @@ private:
 	int m_frmSize{};
 	float m_sahCost{};
 
+	// built tree is stored on disk by key of mesh content and build params
+	static constexpr uint32_t CacheMagic{ 0x48425643 }; // "CVBH"
+	// bumped whenever builders produce other trees for same params
+	static constexpr uint32_t CacheVersion{ 3 };
+	static constexpr size_t CacheAlignment{ 64 };
+	// least recently used trees are removed above size, any tree after age
+	static constexpr uintmax_t CacheBytesMax{ 1ull << 30 };
+	static constexpr int CacheDaysMax{ 30 };
+
+	struct CacheHeader {
+		uint32_t magic{ CacheMagic };
+		uint32_t version{ CacheVersion };
+		uint64_t key{};
+		uint64_t nodesOffset{};
+		uint64_t primRefsOffset{};
+		uint64_t flatTrisOffset{};
+		uint32_t nodesCnt{};
+		uint32_t primRefsCnt{};
+		uint32_t flatTrisCnt{};
+		int primsCntOrig{};
+		int primsCnt{};
+		int nodesUsed{};
+		int leafsCnt{};
+		int depthMin{};
+		int depthMax{};
+		int frmSize{};
+		int clampedCnt{};
+		int splitCnt{};
+		float clamp{};
+		float sahCost{};
+		// mesh tree was built for, checked on load besides key
+		int trisCnt{};
+		int verticesCnt{};
+		uint8_t reserved[24]{};
+	};
+	static_assert(sizeof(CacheHeader) == 2 * CacheAlignment);
+
+	bool m_cacheOn{ true };
+	bool m_isCached{};
+
+	// bytes committed by tree arrays during last build, cached trees keep previous value
+	size_t m_buildMemory{};
+
 public:
 	void render(ID3D11SamplerState* pSampler, ID3D11Buffer* pSceneBuffer);
 
-	void build(Vector4* vts, INT vtsCnt, XMINT4* ids, INT idsCnt, Matrix modelMatrix);
+	void build(const MeshView& mesh, Matrix modelMatrix);
+
+	// every parameter affecting built tree
+	template <typename F>
+	void forEachParam(F f) {
+		f("algBuild", m_algBuild);
+		f("primsPerLeaf", m_primsPerLeaf);
+		f("sahSteps", m_sahSteps);
+		f("costTraversal", m_costTraversal);
+		f("costTraversalWide", m_costTraversalWide);
+		f("costIntersect", m_costIntersect);
+		f("algInsert", m_algInsert);
+		f("algSubsetBuild", m_algSubsetBuild);
+		f("algSubsetSBVHOverlap", m_algSubsetSBVHOverlap);
+		f("algNotSubsetBuild", m_algNotSubsetBuild);
+		f("algNotSubsetSBVHOverlap", m_algNotSubsetSBVHOverlap);
+		f("algSBVHOverlap", m_algSBVHOverlap);
+		f("algInsertSplit", m_algInsertSplit);
+		f("insertSplitOvergrow", m_insertSplitOvergrow);
+		f("algInsertConds", m_algInsertConds);
+		f("toQBVH", m_toQBVH);
+		f("algLayout", m_algLayout);
+		f("layoutTreeletLines", m_layoutTreeletLines);
+		f("flatTrisOn", m_flatTrisOn);
+		f("primSplitting", m_primSplitting);
+		f("primWeightMin", m_primWeightMin);
+		f("primWeightMax", m_primWeightMax);
+		f("clampBase", m_clampBase);
+		f("clampOffset", m_clampOffset);
+		f("clampBinCnt", m_clampBinCnt);
+		f("frmPart", m_frmPart);
+		f("uniform", m_uniform);
+		f("insertSearchWindow", m_insertSearchWindow);
+	}
+
+	// "name value" per line for names of forEachParam, unknown names are skipped
+	bool loadParams(const std::string& path);
+	bool saveParams(const std::string& path);
+
+	uint64_t cacheKey(const MeshView& mesh, Matrix modelMatrix);
+	bool loadCache(const std::string& path, uint64_t key, const MeshView& mesh);
+	bool saveCache(const std::string& path, uint64_t key, const MeshView& mesh);
+	void evictCache(const std::string& dir);
+
+	bool isCached() {
+		return m_isCached;
+	}
+
+	void setCacheOn(bool isOn) {
+		m_cacheOn = isOn;
+	}
+
+	struct BuildStats {
+		float sahCost{};
+		int primsCnt{};
+		int nodesCnt{};
+		int leafsCnt{};
+		// leaf depths in levels of built tree, wide levels if isWide
+		bool isWide{};
+		int depthMin{};
+		int depthMax{};
+		int splitCnt{};
+		size_t buildMemory{};
+	};
+	BuildStats getBuildStats();
 
 	float costSAH(int nodeId = 0);
 
+	// min and max leaf depth measured on built tree
+	std::pair<int, int> leafDepths();
+
+	void reorderNodes(const std::vector<unsigned>& visits = {});
+
+	int getLayout() {
+		return m_algLayout;
+	}
+
+	void setLayout(int alg) {
+		m_algLayout = alg;
+	}
+
+	bool isWide() {
+		return m_algBuild == 5 || m_toQBVH;
+	}
+
+	// what last build produced, checkbox applies only on next build
+	bool isFlatTris() {
+		return !m_flatTris.empty();
+	}
+
 	int depth(int id) {
 		int d{};
 		for (; id; id = m_nodes[id].leftCntPar.z) ++d;
@@ -222,9 +423,29 @@ public:
 	}
 
 private:
-	void init(Vector4* vts, INT vtsCnt, XMINT4* ids, INT idsCnt, Matrix modelMatrix);
+	// traversal cost of split for width of tree being built
+	float costNode() const {
+		return m_toQBVH ? m_costTraversalWide : m_costTraversal;
+	}
+
+	float costLeaf(float primsCnt) const {
+		return m_costIntersect * primsCnt;
+	}
+
+	// sah of split normalized by node area
+	float costSplit(float area, float lCnt, float lArea, float rCnt, float rArea) const {
+		return costNode() + m_costIntersect * (lCnt * lArea + rCnt * rArea) / area;
+	}
+
+	void init(const MeshView& mesh, Matrix modelMatrix);
+
+	void reserveNodes(int cnt);
+	void shrinkToFit();
 
-	void buildPsr(Vector4* vts, INT vtsCnt, XMINT4* ids, INT idsCnt, Matrix modelMatrix);
+	void buildTree(const MeshView& mesh, Matrix modelMatrix);
+	void finalizeTree(const MeshView& mesh, Matrix modelMatrix);
+	void buildPsr(const MeshView& mesh, Matrix modelMatrix);
+	void buildFlatTris(const MeshView& mesh, Matrix modelMatrix);
 	void binaryBVH2QBVH();
 	void buildStochastic();
 
@@ -0,0 +1,1120 @@
+#include "CPUTracer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <random>
+#include <utility>
+
+#include "Parallel.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+void CPUTracer::update(const MeshView& mesh, Matrix modelMatrix) {
+	m_mesh = mesh;
+	m_modelMatrix = modelMatrix;
+	m_isDirty = true;
+}
+
+CPUTracer::Stats CPUTracer::merge(const std::vector<Stats>& parts, double timeMs) {
+	Stats stats{};
+	for (const Stats& part : parts) {
+		stats.rays += part.rays;
+		stats.hits += part.hits;
+		stats.nodesVisited += part.nodesVisited;
+		stats.primsTested += part.primsTested;
+		stats.cacheMisses += part.cacheMisses;
+	}
+	stats.timeMs = timeMs;
+	stats.mraysPerSec = stats.rays / timeMs / 1e3;
+
+	return stats;
+}
+
+void CPUTracer::prepare() {
+	// flat triangles are already in world space
+	if (!m_isDirty || m_pBVH->isFlatTris())
+		return;
+
+	m_vertices.resize(m_mesh.verticesCnt);
+	Parallel::forEach(0, m_mesh.verticesCnt, [&](int i) {
+		m_vertices[i] = Vector3::Transform(Vector3{ m_mesh.pVertices[i] }, m_modelMatrix);
+	}, 4096);
+
+	m_isDirty = false;
+}
+
+CPUTracer::Ray CPUTracer::generateRay(const Matrix& pvInv, const Vector4& whnf, float x, float y) const {
+	auto pixelToWorld = [&](float depth) {
+		Vector4 ndc{
+			2.f * x / whnf.x - 1.f,
+			1.f - 2.f * y / whnf.y,
+			(1.f - depth) / (whnf.z - whnf.w),
+			1.f
+		};
+
+		Vector4 res{ Vector4::Transform(ndc, pvInv) };
+		return res / res.w;
+	};
+
+	Ray ray{};
+	ray.orig = pixelToWorld(0.f);
+
+	Vector4 dest{ pixelToWorld(1.f) };
+	(dest - ray.orig).Normalize(ray.dir);
+	ray.invDir = { 1.f / ray.dir.x, 1.f / ray.dir.y, 1.f / ray.dir.z, 0.f };
+
+	return ray;
+}
+
+float CPUTracer::intersectAABB(const Ray& ray, const AABB& bb, float tmin, float tmax) const {
+	float tx1{ (bb.bmin.x - ray.orig.x) * ray.invDir.x };
+	float tx2{ (bb.bmax.x - ray.orig.x) * ray.invDir.x };
+	float ty1{ (bb.bmin.y - ray.orig.y) * ray.invDir.y };
+	float ty2{ (bb.bmax.y - ray.orig.y) * ray.invDir.y };
+	float tz1{ (bb.bmin.z - ray.orig.z) * ray.invDir.z };
+	float tz2{ (bb.bmax.z - ray.orig.z) * ray.invDir.z };
+
+	float tEntry{ std::max<float>(std::max<float>(std::min<float>(tx1, tx2), std::min<float>(ty1, ty2)), std::min<float>(tz1, tz2)) };
+	float tExit{ std::min<float>(std::min<float>(std::max<float>(tx1, tx2), std::max<float>(ty1, ty2)), std::max<float>(tz1, tz2)) };
+
+	return tmin < tExit && tEntry <= tExit && tEntry < tmax ? tEntry : std::numeric_limits<float>::infinity();
+}
+
+// Moller-Trumbore, same as in RayTracingCS
+CPUTracer::Intsec CPUTracer::intersectTri(const Ray& ray, const Vector3& v0, const Vector3& e1, const Vector3& e2) const {
+	Intsec intsec{};
+	intsec.t = -1.f;
+
+	Vector3 dir{ ray.dir.x, ray.dir.y, ray.dir.z };
+
+	Vector3 h{ dir.Cross(e2) };
+	float a{ e1.Dot(h) };
+
+	// check is parallel
+	if (std::abs(a) < 1e-8f)
+		return intsec;
+
+	Vector3 s{ ray.orig.x - v0.x, ray.orig.y - v0.y, ray.orig.z - v0.z };
+	intsec.u = s.Dot(h) / a;
+
+	if (intsec.u < 0.f || 1.f < intsec.u)
+		return intsec;
+
+	Vector3 q{ s.Cross(e1) };
+	intsec.v = dir.Dot(q) / a;
+
+	if (intsec.v < 0.f || 1.f < intsec.u + intsec.v)
+		return intsec;
+
+	intsec.t = e2.Dot(q) / a;
+	return intsec;
+}
+
+// returns prim id, edges form for both flat and indexed triangles
+int CPUTracer::loadTri(int primRefId, Vector3& v0, Vector3& e1, Vector3& e2, Counters& cnt) const {
+	++cnt.prims;
+	TRACER_STAT(++cnt.ray.tris);
+
+	// one contiguous read per triangle
+	if (m_pBVH->isFlatTris()) {
+		const BVH::FlatTri& tri{ m_pBVH->m_flatTris[primRefId] };
+		if (cnt.pCache)
+			cnt.pCache->touch(&tri, sizeof(BVH::FlatTri));
+
+		v0 = tri.v0;
+		e1 = tri.e1;
+		e2 = tri.e2;
+		return tri.primId;
+	}
+
+	const BVH::PrimRef& primRef{ m_pBVH->m_primRefs[primRefId] };
+	XMUINT3 ids{ m_mesh.tri(primRef.primId) };
+	const Vector3& w0{ m_vertices[ids.x] };
+	const Vector3& w1{ m_vertices[ids.y] };
+	const Vector3& w2{ m_vertices[ids.z] };
+
+	if (cnt.pCache) {
+		cnt.pCache->touch(&primRef, sizeof(BVH::PrimRef));
+		cnt.pCache->touch(m_mesh.triData(primRef.primId), 3ull * m_mesh.indexSize);
+		cnt.pCache->touch(&w0, sizeof(Vector3));
+		cnt.pCache->touch(&w1, sizeof(Vector3));
+		cnt.pCache->touch(&w2, sizeof(Vector3));
+	}
+
+	v0 = w0;
+	e1 = w1 - w0;
+	e2 = w2 - w0;
+	return static_cast<int>(primRef.primId);
+}
+
+CPUTracer::Intsec CPUTracer::intersectPrim(const Ray& ray, int primRefId, Counters& cnt) const {
+	Vector3 v0{}, e1{}, e2{};
+	int tId{ loadTri(primRefId, v0, e1, e2, cnt) };
+
+	Intsec intsec{ intersectTri(ray, v0, e1, e2) };
+	intsec.tId = tId;
+	return intsec;
+}
+
+CPUTracer::Intsec CPUTracer::intersect(const Ray& ray, float tmin, float tmax) {
+	prepare();
+
+	Counters cnt{};
+	return intersect(ray, tmin, tmax, cnt);
+}
+
+Vector3 CPUTracer::normal(int primId) const {
+	XMUINT3 ids{ m_mesh.tri(primId) };
+	Vector4 v0{ Vector4::Transform(m_mesh.vertex(ids.x), m_modelMatrix) };
+	Vector4 v1{ Vector4::Transform(m_mesh.vertex(ids.y), m_modelMatrix) };
+	Vector4 v2{ Vector4::Transform(m_mesh.vertex(ids.z), m_modelMatrix) };
+
+	Vector3 n{ Vector3{ v1.x - v0.x, v1.y - v0.y, v1.z - v0.z }.Cross({ v2.x - v0.x, v2.y - v0.y, v2.z - v0.z }) };
+	n.Normalize();
+
+	return n;
+}
+
+// stack traversal with nearest child first, both for binary and wide nodes
+CPUTracer::Intsec CPUTracer::intersect(const Ray& ray, float tmin, float tmax, Counters& cnt, int rootId) const {
+	const std::vector<BVH::BVHNode>& nodes{ m_pBVH->m_nodes };
+	bool isWide{ m_pBVH->isWide() };
+
+	Intsec best{};
+	best.t = tmax;
+
+	auto visit = [&](int nodeId) {
+		++cnt.nodes;
+		TRACER_STAT(++cnt.ray.boxes);
+		if (cnt.pVisits)
+			std::atomic_ref<unsigned>(cnt.pVisits[nodeId]).fetch_add(1, std::memory_order_relaxed);
+		if (cnt.pCache)
+			cnt.pCache->touch(&nodes[nodeId], sizeof(BVH::BVHNode));
+	};
+
+	std::pair<int, float> stack[StackSize]{};
+	int stackSize{};
+
+	visit(rootId);
+	float tRoot{ intersectAABB(ray, nodes[rootId].bb, tmin, best.t) };
+	if (tRoot < best.t)
+		stack[stackSize++] = { rootId, tRoot };
+
+	while (stackSize) {
+		TRACER_STAT(++cnt.ray.iters);
+		TRACER_STAT(cnt.ray.depth = std::max<int>(cnt.ray.depth, stackSize));
+
+		auto [nodeId, tNode] = stack[--stackSize];
+		if (best.t <= tNode)
+			continue;
+
+		const BVH::BVHNode& node{ nodes[nodeId] };
+		TRACER_STAT(++cnt.ray.nodes);
+
+		if (node.leftCntPar.y) {
+			for (int i{ node.leftCntPar.x }; i < node.leftCntPar.x + node.leftCntPar.y; ++i) {
+				Intsec curr{ intersectPrim(ray, i, cnt) };
+				if (tmin < curr.t && curr.t < best.t)
+					best = curr;
+			}
+			continue;
+		}
+
+		std::pair<int, float> hits[4]{};
+		int hitsCnt{};
+
+		int childsCnt{ isWide ? node.leftCntPar.w : 2 };
+		for (int i{}; i < childsCnt; ++i) {
+			int child{ node.leftCntPar.x + i };
+			visit(child);
+
+			float t{ intersectAABB(ray, nodes[child].bb, tmin, best.t) };
+			if (t < best.t)
+				hits[hitsCnt++] = { child, t };
+		}
+
+		// farthest pushed first, subtrees not fitting full stack are traversed by nested call
+		std::sort(hits, hits + hitsCnt, [](const auto& a, const auto& b) { return a.second > b.second; });
+		for (int i{}; i < hitsCnt; ++i) {
+			if (stackSize < StackSize) {
+				stack[stackSize++] = hits[i];
+				continue;
+			}
+
+			Intsec curr{ intersect(ray, tmin, best.t, cnt, hits[i].first) };
+			if (curr.t < best.t)
+				best = curr;
+		}
+	}
+
+	return best;
+}
+
+// port of bvhStacklessIntersectionQBVH from RayTracingCS for binary and wide trees:
+// parent links and per level index of current child among hit ones replace stack,
+// children hits are sorted again each time sibling is taken
+CPUTracer::Intsec CPUTracer::intersectStackless(const Ray& ray, float tmin, float tmax, Counters& cnt) const {
+	const std::vector<BVH::BVHNode>& nodes{ m_pBVH->m_nodes };
+	bool isWide{ m_pBVH->isWide() };
+
+	Intsec best{};
+	best.t = tmax;
+
+	auto visit = [&](int nodeId) {
+		++cnt.nodes;
+		TRACER_STAT(++cnt.ray.boxes);
+		if (cnt.pVisits)
+			std::atomic_ref<unsigned>(cnt.pVisits[nodeId]).fetch_add(1, std::memory_order_relaxed);
+		if (cnt.pCache)
+			cnt.pCache->touch(&nodes[nodeId], sizeof(BVH::BVHNode));
+	};
+
+	// k-th nearest child hit before tmax, k becomes 4 after last one, -1 if none is hit
+	auto nearChild = [&](int nodeId, int& k) {
+		const BVH::BVHNode& node{ nodes[nodeId] };
+
+		std::pair<int, float> hits[4]{};
+		int hitsCnt{};
+
+		int childsCnt{ isWide ? node.leftCntPar.w : 2 };
+		for (int i{}; i < childsCnt; ++i) {
+			int child{ node.leftCntPar.x + i };
+			visit(child);
+
+			float t{ intersectAABB(ray, nodes[child].bb, tmin, tmax) };
+			if (t < tmax)
+				hits[hitsCnt++] = { child, t };
+		}
+
+		if (k >= hitsCnt) {
+			k = 4;
+			return -1;
+		}
+
+		std::sort(hits, hits + hitsCnt, [](const auto& a, const auto& b) { return a.second < b.second; });
+		int res{ hits[k].first };
+		if (k == hitsCnt - 1)
+			k = 4;
+		return res;
+	};
+
+	visit(0);
+	if (!(intersectAABB(ray, nodes[0].bb, tmin, tmax) < tmax))
+		return best;
+
+	// tree of single leaf has nothing to walk
+	if (nodes[0].leftCntPar.y) {
+		for (int i{ nodes[0].leftCntPar.x }; i < nodes[0].leftCntPar.x + nodes[0].leftCntPar.y; ++i) {
+			Intsec curr{ intersectPrim(ray, i, cnt) };
+			if (tmin < curr.t && curr.t < best.t)
+				best = curr;
+		}
+		return best;
+	}
+
+	int trail[StackSize]{};
+	int level{};
+
+	int nodeId{ nearChild(0, trail[level]) };
+	bool isEnter{ true };
+
+	for (int iters{}; nodeId > 0 && iters < MaxStacklessIters; ++iters) {
+		TRACER_STAT(++cnt.ray.iters);
+		TRACER_STAT(cnt.ray.depth = std::max<int>(cnt.ray.depth, level + 1));
+
+		const BVH::BVHNode& node{ nodes[nodeId] };
+
+		if (isEnter) {
+			visit(nodeId);
+			if (intersectAABB(ray, node.bb, tmin, best.t) < best.t) {
+				TRACER_STAT(++cnt.ray.nodes);
+
+				if (!node.leftCntPar.y && level + 1 < StackSize) {
+					trail[++level] = 0;
+					int child{ nearChild(nodeId, trail[level]) };
+					if (child >= 0) {
+						nodeId = child;
+						continue;
+					}
+					--level;
+				}
+
+				for (int i{ node.leftCntPar.x }; node.leftCntPar.y && i < node.leftCntPar.x + node.leftCntPar.y; ++i) {
+					Intsec curr{ intersectPrim(ray, i, cnt) };
+					if (tmin < curr.t && curr.t < best.t)
+						best = curr;
+				}
+			}
+		}
+
+		// node is done: next hit sibling or back to parent
+		if (++trail[level] >= 4) {
+			--level;
+			nodeId = node.leftCntPar.z;
+			isEnter = false;
+		}
+		else {
+			nodeId = nearChild(node.leftCntPar.z, trail[level]);
+			isEnter = true;
+		}
+	}
+
+	return best;
+}
+
+bool CPUTracer::occluded(const Ray& ray, float tmin, float tmax) {
+	prepare();
+
+	Counters cnt{};
+	return occluded(ray, tmin, tmax, cnt);
+}
+
+// stops at first hit, children are pushed in memory order
+bool CPUTracer::occluded(const Ray& ray, float tmin, float tmax, Counters& cnt) const {
+	const std::vector<BVH::BVHNode>& nodes{ m_pBVH->m_nodes };
+	bool isWide{ m_pBVH->isWide() };
+
+	auto visit = [&](int nodeId) {
+		++cnt.nodes;
+		if (cnt.pVisits)
+			std::atomic_ref<unsigned>(cnt.pVisits[nodeId]).fetch_add(1, std::memory_order_relaxed);
+		if (cnt.pCache)
+			cnt.pCache->touch(&nodes[nodeId], sizeof(BVH::BVHNode));
+	};
+
+	int stack[StackSize]{};
+	int stackSize{};
+
+	visit(0);
+	if (intersectAABB(ray, nodes[0].bb, tmin, tmax) < tmax)
+		stack[stackSize++] = 0;
+
+	while (stackSize) {
+		const BVH::BVHNode& node{ nodes[stack[--stackSize]] };
+
+		if (node.leftCntPar.y) {
+			for (int i{ node.leftCntPar.x }; i < node.leftCntPar.x + node.leftCntPar.y; ++i) {
+				Intsec curr{ intersectPrim(ray, i, cnt) };
+				if (tmin < curr.t && curr.t < tmax)
+					return true;
+			}
+			continue;
+		}
+
+		int childsCnt{ isWide ? node.leftCntPar.w : 2 };
+		for (int i{ childsCnt - 1 }; i >= 0; --i) {
+			int child{ node.leftCntPar.x + i };
+			visit(child);
+
+			if (intersectAABB(ray, nodes[child].bb, tmin, tmax) < tmax) {
+				// conservative on overflow, as bvhOcclusion in RayTracingCS
+				if (stackSize == StackSize)
+					return true;
+				stack[stackSize++] = child;
+			}
+		}
+	}
+
+	return false;
+}
+
+void CPUTracer::occluded(const std::vector<OcclusionQuery>& queries, std::vector<unsigned char>& results) {
+	prepare();
+
+	results.resize(queries.size());
+
+	Parallel::forEach(0, static_cast<int>(queries.size()), [&](int i) {
+		Counters cnt{};
+		results[i] = occluded(queries[i].ray, queries[i].tmin, queries[i].tmax, cnt);
+	}, 256);
+}
+
+CPUTracer::Stats CPUTracer::occluded(RayStream& stream) {
+	prepare();
+
+	int chunksCnt{ (stream.size() + 255) / 256 };
+	std::vector<Stats> chunks(chunksCnt);
+
+	m_timer.start();
+
+	Parallel::forEach(0, chunksCnt, [&](int c) {
+		CacheModel cache{};
+		Counters cnt{ .pCache{ m_simulateCache ? &cache : nullptr } };
+
+		int last{ std::min<int>(stream.size(), (c + 1) * 256) };
+		for (int i{ c * 256 }; i < last; ++i) {
+			stream.tId[i] = occluded(stream.ray(i), stream.tmin[i], stream.tmax[i], cnt) ? 0 : -1;
+			chunks[c].hits += stream.tId[i] == 0;
+		}
+
+		chunks[c].rays = last - c * 256;
+		chunks[c].nodesVisited = cnt.nodes;
+		chunks[c].primsTested = cnt.prims;
+		chunks[c].cacheMisses = cache.misses;
+	});
+
+	m_timer.stop();
+
+	return merge(chunks, m_timer.getTime());
+}
+
+std::pair<CPUTracer::Stats, CPUTracer::Stats> CPUTracer::benchShadows(const Matrix& pvInv, const Vector4& whnf, const Vector4& lightPos) {
+	prepare();
+
+	int width{ static_cast<int>(whnf.x) };
+	int height{ static_cast<int>(whnf.y) };
+
+	// shadow rays of primary hits
+	std::vector<std::vector<OcclusionQuery>> rows(height);
+	Parallel::forEach(0, height, [&](int y) {
+		Counters cnt{};
+		for (int x{}; x < width; ++x) {
+			Ray ray{ generateRay(pvInv, whnf, x + .5f, y + .5f) };
+			Intsec best{ intersect(ray, whnf.z, whnf.w, cnt) };
+			if (best.tId < 0)
+				continue;
+
+			OcclusionQuery query{};
+			query.ray.orig = ray.orig + best.t * ray.dir;
+			query.ray.orig.w = 1.f;
+
+			Vector4 toLight{ lightPos - query.ray.orig };
+			toLight.w = 0.f;
+			query.tmax = toLight.Length();
+			query.tmin = 1e-4f * query.tmax;
+
+			query.ray.dir = toLight / query.tmax;
+			query.ray.invDir = { 1.f / query.ray.dir.x, 1.f / query.ray.dir.y, 1.f / query.ray.dir.z, 0.f };
+
+			rows[y].push_back(query);
+		}
+	});
+
+	std::vector<OcclusionQuery> queries{};
+	for (const auto& row : rows)
+		queries.insert(queries.end(), row.begin(), row.end());
+
+	int chunksCnt{ static_cast<int>((queries.size() + 255) / 256) };
+
+	auto run = [&](bool isOcclusion) {
+		std::vector<Stats> chunks(chunksCnt);
+
+		m_timer.start();
+
+		Parallel::forEach(0, chunksCnt, [&](int c) {
+			CacheModel cache{};
+			Counters cnt{ .pCache{ m_simulateCache ? &cache : nullptr } };
+
+			int last{ std::min<int>(static_cast<int>(queries.size()), (c + 1) * 256) };
+			for (int i{ c * 256 }; i < last; ++i) {
+				const OcclusionQuery& query{ queries[i] };
+				chunks[c].hits += isOcclusion
+					? occluded(query.ray, query.tmin, query.tmax, cnt)
+					: intersect(query.ray, query.tmin, query.tmax, cnt).tId >= 0;
+			}
+
+			chunks[c].rays = last - c * 256;
+			chunks[c].nodesVisited = cnt.nodes;
+			chunks[c].primsTested = cnt.prims;
+			chunks[c].cacheMisses = cache.misses;
+		});
+
+		m_timer.stop();
+
+		return merge(chunks, m_timer.getTime());
+	};
+
+	Stats closest{ run(false) };
+	Stats occlusion{ run(true) };
+
+	return { closest, occlusion };
+}
+
+CPUTracer::Stats CPUTracer::traceFrame(const Matrix& pvInv, const Vector4& whnf) {
+	prepare();
+
+	int width{ static_cast<int>(whnf.x) };
+	int height{ static_cast<int>(whnf.y) };
+
+	if (m_countVisits)
+		m_nodeVisits.assign(m_pBVH->m_nodesUsed, 0);
+	TRACER_STAT(m_rayStats.assign(static_cast<size_t>(width) * height, {}));
+
+	std::vector<Stats> rows(height);
+
+	m_timer.start();
+
+	Parallel::forEach(0, height, [&](int y) {
+		CacheModel cache{};
+		Counters cnt{
+			.pCache{ m_simulateCache ? &cache : nullptr },
+			.pVisits{ m_countVisits ? m_nodeVisits.data() : nullptr }
+		};
+
+		for (int x{}; x < width; ++x) {
+			Ray ray{ generateRay(pvInv, whnf, x + .5f, y + .5f) };
+			Intsec best{ m_isStackless ? intersectStackless(ray, whnf.z, whnf.w, cnt) : intersect(ray, whnf.z, whnf.w, cnt) };
+			rows[y].hits += best.tId >= 0;
+			TRACER_STAT(m_rayStats[static_cast<size_t>(y) * width + x] = std::exchange(cnt.ray, {}));
+		}
+
+		rows[y].rays = width;
+		rows[y].nodesVisited = cnt.nodes;
+		rows[y].primsTested = cnt.prims;
+		rows[y].cacheMisses = cache.misses;
+	});
+
+	m_timer.stop();
+
+	return merge(rows, m_timer.getTime());
+}
+
+// returns false if ray directions differ in sign, such packet is traced by single rays
+bool CPUTracer::initPacket(Packet& packet, const Matrix& pvInv, const Vector4& whnf, int tileX, int tileY) const {
+	packet.cnt = 0;
+
+	for (int ty{}; ty < Packet::TileSize; ++ty) {
+		for (int tx{}; tx < Packet::TileSize; ++tx) {
+			int x{ tileX * Packet::TileSize + tx };
+			int y{ tileY * Packet::TileSize + ty };
+			if (whnf.x <= x || whnf.y <= y)
+				continue;
+
+			Ray ray{ generateRay(pvInv, whnf, x + .5f, y + .5f) };
+
+			// keep reciprocals finite for interval arithmetic
+			for (float* d : { &ray.dir.x, &ray.dir.y, &ray.dir.z }) {
+				if (std::abs(*d) < 1e-8f)
+					*d = std::copysign(1e-8f, *d);
+			}
+
+			int i{ packet.cnt++ };
+			packet.ox[i] = ray.orig.x;
+			packet.oy[i] = ray.orig.y;
+			packet.oz[i] = ray.orig.z;
+			packet.dx[i] = ray.dir.x;
+			packet.dy[i] = ray.dir.y;
+			packet.dz[i] = ray.dir.z;
+			packet.ix[i] = 1.f / ray.dir.x;
+			packet.iy[i] = 1.f / ray.dir.y;
+			packet.iz[i] = 1.f / ray.dir.z;
+			packet.tmax[i] = whnf.w;
+			packet.tId[i] = -1;
+		}
+	}
+
+	for (int i{ packet.cnt }; i < Packet::Size; ++i) {
+		packet.ox[i] = packet.oy[i] = packet.oz[i] = 0.f;
+		packet.dx[i] = packet.dy[i] = packet.dz[i] = 1.f;
+		packet.ix[i] = packet.iy[i] = packet.iz[i] = 1.f;
+		packet.tmax[i] = -std::numeric_limits<float>::infinity();
+		packet.tId[i] = -1;
+	}
+
+	packet.origMin = packet.origMax = { packet.ox[0], packet.oy[0], packet.oz[0] };
+	packet.invMin = packet.invMax = { packet.ix[0], packet.iy[0], packet.iz[0] };
+	for (int i{ 1 }; i < packet.cnt; ++i) {
+		Vector3 orig{ packet.ox[i], packet.oy[i], packet.oz[i] };
+		Vector3 inv{ packet.ix[i], packet.iy[i], packet.iz[i] };
+		packet.origMin = Vector3::Min(packet.origMin, orig);
+		packet.origMax = Vector3::Max(packet.origMax, orig);
+		packet.invMin = Vector3::Min(packet.invMin, inv);
+		packet.invMax = Vector3::Max(packet.invMax, inv);
+	}
+	packet.tmaxMax = whnf.w;
+
+	return (packet.invMin.x > 0.f || packet.invMax.x < 0.f)
+		&& (packet.invMin.y > 0.f || packet.invMax.y < 0.f)
+		&& (packet.invMin.z > 0.f || packet.invMax.z < 0.f);
+}
+
+// interval arithmetic: true if any ray of packet may hit the box
+bool CPUTracer::packetHitsAABB(const Packet& packet, const AABB& bb, float tmin) const {
+	auto range = [](float a0, float a1, float b0, float b1) {
+		float p0{ a0 * b0 }, p1{ a0 * b1 }, p2{ a1 * b0 }, p3{ a1 * b1 };
+		return std::pair<float, float>{
+			std::min<float>(std::min<float>(p0, p1), std::min<float>(p2, p3)),
+			std::max<float>(std::max<float>(p0, p1), std::max<float>(p2, p3))
+		};
+	};
+
+	float tEntry{ tmin };
+	float tExit{ packet.tmaxMax };
+
+	const float bmin[3]{ bb.bmin.x, bb.bmin.y, bb.bmin.z };
+	const float bmax[3]{ bb.bmax.x, bb.bmax.y, bb.bmax.z };
+	const float origMin[3]{ packet.origMin.x, packet.origMin.y, packet.origMin.z };
+	const float origMax[3]{ packet.origMax.x, packet.origMax.y, packet.origMax.z };
+	const float invMin[3]{ packet.invMin.x, packet.invMin.y, packet.invMin.z };
+	const float invMax[3]{ packet.invMax.x, packet.invMax.y, packet.invMax.z };
+
+	for (int a{}; a < 3; ++a) {
+		float nearPlane{ invMin[a] > 0.f ? bmin[a] : bmax[a] };
+		float farPlane{ invMin[a] > 0.f ? bmax[a] : bmin[a] };
+
+		tEntry = std::max<float>(tEntry, range(nearPlane - origMax[a], nearPlane - origMin[a], invMin[a], invMax[a]).first);
+		tExit = std::min<float>(tExit, range(farPlane - origMax[a], farPlane - origMin[a], invMin[a], invMax[a]).second);
+	}
+
+	return tEntry <= tExit;
+}
+
+// Moller-Trumbore for one triangle and 4 rays, returns hit mask and t
+__m128 CPUTracer::intersectTri4(const __m128 orig[3], const __m128 dir[3], __m128 tmin, __m128 tmax,
+	const Vector3& v0, const Vector3& e1, const Vector3& e2, __m128& t) {
+	__m128 e1x{ _mm_set1_ps(e1.x) }, e1y{ _mm_set1_ps(e1.y) }, e1z{ _mm_set1_ps(e1.z) };
+	__m128 e2x{ _mm_set1_ps(e2.x) }, e2y{ _mm_set1_ps(e2.y) }, e2z{ _mm_set1_ps(e2.z) };
+	const __m128& dx{ dir[0] };
+	const __m128& dy{ dir[1] };
+	const __m128& dz{ dir[2] };
+
+	// h = d x e2, a = e1 . h
+	__m128 hx{ _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y)) };
+	__m128 hy{ _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z)) };
+	__m128 hz{ _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x)) };
+	__m128 a{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz)) };
+	__m128 invA{ _mm_div_ps(_mm_set1_ps(1.f), a) };
+
+	__m128 sx{ _mm_sub_ps(orig[0], _mm_set1_ps(v0.x)) };
+	__m128 sy{ _mm_sub_ps(orig[1], _mm_set1_ps(v0.y)) };
+	__m128 sz{ _mm_sub_ps(orig[2], _mm_set1_ps(v0.z)) };
+	__m128 u{ _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)), _mm_mul_ps(sz, hz)), invA) };
+
+	// q = s x e1
+	__m128 qx{ _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y)) };
+	__m128 qy{ _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z)) };
+	__m128 qz{ _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x)) };
+	__m128 v{ _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invA) };
+	t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invA);
+
+	__m128 absMask{ _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)) };
+	__m128 mask{ _mm_cmpge_ps(_mm_and_ps(a, absMask), _mm_set1_ps(1e-8f)) };
+	mask = _mm_and_ps(mask, _mm_cmpge_ps(u, _mm_setzero_ps()));
+	mask = _mm_and_ps(mask, _mm_cmpge_ps(v, _mm_setzero_ps()));
+	mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.f)));
+	mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, tmin));
+	return _mm_and_ps(mask, _mm_cmplt_ps(t, tmax));
+}
+
+void CPUTracer::intersectPacketLeaf(Packet& packet, int primRefFirst, int primRefCnt, int first, float tmin, Counters& cnt) const {
+	int begin{ first & ~3 };
+	int end{ (packet.cnt + 3) & ~3 };
+
+	__m128 tminV{ _mm_set1_ps(tmin) };
+
+	for (int i{ primRefFirst }; i < primRefFirst + primRefCnt; ++i) {
+		Vector3 v0{}, e1{}, e2{};
+		int tId{ loadTri(i, v0, e1, e2, cnt) };
+		cnt.prims += end - begin - 1;
+
+		__m128 tIdV{ _mm_castsi128_ps(_mm_set1_epi32(tId)) };
+
+		for (int r{ begin }; r < end; r += 4) {
+			__m128 orig[3]{ _mm_load_ps(packet.ox + r), _mm_load_ps(packet.oy + r), _mm_load_ps(packet.oz + r) };
+			__m128 dir[3]{ _mm_load_ps(packet.dx + r), _mm_load_ps(packet.dy + r), _mm_load_ps(packet.dz + r) };
+			__m128 tmax{ _mm_load_ps(packet.tmax + r) };
+
+			__m128 t{};
+			__m128 mask{ intersectTri4(orig, dir, tminV, tmax, v0, e1, e2, t) };
+			if (!_mm_movemask_ps(mask))
+				continue;
+
+			_mm_store_ps(packet.tmax + r, _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, tmax)));
+
+			__m128 ids{ _mm_load_ps(reinterpret_cast<float*>(packet.tId + r)) };
+			_mm_store_ps(reinterpret_cast<float*>(packet.tId + r), _mm_or_ps(_mm_and_ps(mask, tIdV), _mm_andnot_ps(mask, ids)));
+		}
+	}
+
+	packet.tmaxMax = *std::max_element(packet.tmax, packet.tmax + packet.cnt);
+}
+
+void CPUTracer::intersectPacket(Packet& packet, float tmin, Counters& cnt) const {
+	const std::vector<BVH::BVHNode>& nodes{ m_pBVH->m_nodes };
+	bool isWide{ m_pBVH->isWide() };
+
+	auto rayT = [&](int i, const AABB& bb) {
+		return intersectAABB(packet.ray(i), bb, tmin, packet.tmax[i]);
+	};
+
+	// subtree by single rays, from first ray on
+	auto intersectSingle = [&](int nodeId, int first, const bool* isActive) {
+		for (int i{ first }; i < packet.cnt; ++i) {
+			if (isActive && !isActive[i])
+				continue;
+
+			Ray ray{ packet.ray(i) };
+			Intsec best{ intersect(ray, tmin, packet.tmax[i], cnt, nodeId) };
+			if (best.tId >= 0 && best.t < packet.tmax[i]) {
+				packet.tmax[i] = best.t;
+				packet.tId[i] = best.tId;
+			}
+		}
+		packet.tmaxMax = *std::max_element(packet.tmax, packet.tmax + packet.cnt);
+	};
+
+	// node and first active ray
+	std::pair<int, int> stack[StackSize]{};
+	int stackSize{};
+	stack[stackSize++] = { 0, 0 };
+
+	while (stackSize) {
+		auto [nodeId, first] = stack[--stackSize];
+		const BVH::BVHNode& node{ nodes[nodeId] };
+
+		++cnt.nodes;
+		if (cnt.pVisits)
+			std::atomic_ref<unsigned>(cnt.pVisits[nodeId]).fetch_add(1, std::memory_order_relaxed);
+		if (cnt.pCache)
+			cnt.pCache->touch(&node, sizeof(BVH::BVHNode));
+
+		if (!packetHitsAABB(packet, node.bb, tmin))
+			continue;
+
+		// first active ray and active rays count
+		bool isActive[Packet::Size]{};
+		int activeCnt{};
+		for (int i{ first }; i < packet.cnt; ++i) {
+			isActive[i] = rayT(i, node.bb) < packet.tmax[i];
+			activeCnt += isActive[i];
+		}
+		while (first < packet.cnt && !isActive[first])
+			++first;
+
+		if (!activeCnt)
+			continue;
+
+		// diverged, rest of subtree by single rays
+		if (activeCnt <= m_packetMinActive) {
+			intersectSingle(nodeId, first, isActive);
+			continue;
+		}
+
+		if (node.leftCntPar.y) {
+			intersectPacketLeaf(packet, node.leftCntPar.x, node.leftCntPar.y, first, tmin, cnt);
+			continue;
+		}
+
+		// children ordered by first active ray, farthest pushed first
+		std::pair<int, float> childs[4]{};
+		int childsCnt{ isWide ? node.leftCntPar.w : 2 };
+		for (int i{}; i < childsCnt; ++i) {
+			int child{ node.leftCntPar.x + i };
+			childs[i] = { child, rayT(first, nodes[child].bb) };
+		}
+		std::sort(childs, childs + childsCnt, [](const auto& a, const auto& b) { return a.second > b.second; });
+
+		// subtrees not fitting full stack go by single rays
+		for (int i{}; i < childsCnt; ++i) {
+			if (stackSize < StackSize)
+				stack[stackSize++] = { childs[i].first, first };
+			else
+				intersectSingle(childs[i].first, first, nullptr);
+		}
+	}
+}
+
+CPUTracer::Stats CPUTracer::traceFramePackets(const Matrix& pvInv, const Vector4& whnf) {
+	prepare();
+
+	int tilesX{ (static_cast<int>(whnf.x) + Packet::TileSize - 1) / Packet::TileSize };
+	int tilesY{ (static_cast<int>(whnf.y) + Packet::TileSize - 1) / Packet::TileSize };
+
+	if (m_countVisits)
+		m_nodeVisits.assign(m_pBVH->m_nodesUsed, 0);
+
+	std::vector<Stats> tiles(tilesX * tilesY);
+
+	m_timer.start();
+
+	Parallel::forEach(0, tilesX * tilesY, [&](int tile) {
+		CacheModel cache{};
+		Counters cnt{
+			.pCache{ m_simulateCache ? &cache : nullptr },
+			.pVisits{ m_countVisits ? m_nodeVisits.data() : nullptr }
+		};
+
+		Packet packet{};
+		if (initPacket(packet, pvInv, whnf, tile % tilesX, tile / tilesX)) {
+			intersectPacket(packet, whnf.z, cnt);
+		}
+		else {
+			for (int i{}; i < packet.cnt; ++i) {
+				Ray ray{ packet.ray(i) };
+				packet.tId[i] = intersect(ray, whnf.z, whnf.w, cnt).tId;
+			}
+		}
+
+		for (int i{}; i < packet.cnt; ++i)
+			tiles[tile].hits += packet.tId[i] >= 0;
+
+		tiles[tile].rays = packet.cnt;
+		tiles[tile].nodesVisited = cnt.nodes;
+		tiles[tile].primsTested = cnt.prims;
+		tiles[tile].cacheMisses = cache.misses;
+	});
+
+	m_timer.stop();
+
+	return merge(tiles, m_timer.getTime());
+}
+
+// keeps ids of rays hitting the box, 4 rays per step
+int CPUTracer::filterStream(const RayStream& stream, int* ids, int idsCnt, const AABB& bb) const {
+	__m128 bmin[3]{ _mm_set1_ps(bb.bmin.x), _mm_set1_ps(bb.bmin.y), _mm_set1_ps(bb.bmin.z) };
+	__m128 bmax[3]{ _mm_set1_ps(bb.bmax.x), _mm_set1_ps(bb.bmax.y), _mm_set1_ps(bb.bmax.z) };
+	const std::vector<float>* orig[3]{ &stream.ox, &stream.oy, &stream.oz };
+	const std::vector<float>* inv[3]{ &stream.ix, &stream.iy, &stream.iz };
+
+	int kept{};
+	for (int i{}; i < idsCnt; i += 4) {
+		int lanes{ std::min<int>(4, idsCnt - i) };
+		int r[4]{ ids[i], ids[i + std::min<int>(1, lanes - 1)], ids[i + std::min<int>(2, lanes - 1)], ids[i + lanes - 1] };
+
+		auto gather = [&](const std::vector<float>& a) {
+			return _mm_set_ps(a[r[3]], a[r[2]], a[r[1]], a[r[0]]);
+		};
+
+		__m128 tEntry{ gather(stream.tmin) };
+		__m128 tExit{ gather(stream.tmax) };
+		for (int a{}; a < 3; ++a) {
+			__m128 o{ gather(*orig[a]) };
+			__m128 iv{ gather(*inv[a]) };
+			__m128 t1{ _mm_mul_ps(_mm_sub_ps(bmin[a], o), iv) };
+			__m128 t2{ _mm_mul_ps(_mm_sub_ps(bmax[a], o), iv) };
+			tEntry = _mm_max_ps(tEntry, _mm_min_ps(t1, t2));
+			tExit = _mm_min_ps(tExit, _mm_max_ps(t1, t2));
+		}
+
+		int mask{ _mm_movemask_ps(_mm_cmple_ps(tEntry, tExit)) & ((1 << lanes) - 1) };
+		for (int l{}; l < lanes; ++l) {
+			if (mask & (1 << l))
+				ids[kept++] = r[l];
+		}
+	}
+
+	return kept;
+}
+
+void CPUTracer::intersectStreamLeaf(RayStream& stream, const int* ids, int idsCnt, int primRefFirst, int primRefCnt, Counters& cnt) const {
+	for (int i{ primRefFirst }; i < primRefFirst + primRefCnt; ++i) {
+		Vector3 v0{}, e1{}, e2{};
+		int tId{ loadTri(i, v0, e1, e2, cnt) };
+		cnt.prims += idsCnt - 1;
+
+		for (int j{}; j < idsCnt; j += 4) {
+			int lanes{ std::min<int>(4, idsCnt - j) };
+			int r[4]{ ids[j], ids[j + std::min<int>(1, lanes - 1)], ids[j + std::min<int>(2, lanes - 1)], ids[j + lanes - 1] };
+
+			auto gather = [&](const std::vector<float>& a) {
+				return _mm_set_ps(a[r[3]], a[r[2]], a[r[1]], a[r[0]]);
+			};
+
+			__m128 orig[3]{ gather(stream.ox), gather(stream.oy), gather(stream.oz) };
+			__m128 dir[3]{ gather(stream.dx), gather(stream.dy), gather(stream.dz) };
+
+			__m128 t{};
+			int mask{ _mm_movemask_ps(intersectTri4(orig, dir, gather(stream.tmin), gather(stream.tmax), v0, e1, e2, t)) & ((1 << lanes) - 1) };
+			if (!mask)
+				continue;
+
+			alignas(16) float ts[4]{};
+			_mm_store_ps(ts, t);
+			for (int l{}; l < lanes; ++l) {
+				if (mask & (1 << l) && ts[l] < stream.tmax[r[l]]) {
+					stream.tmax[r[l]] = ts[l];
+					stream.tId[r[l]] = tId;
+				}
+			}
+		}
+	}
+}
+
+// every stack frame owns a segment of active ray ids, segments are freed in LIFO order
+void CPUTracer::intersectStream(RayStream& stream, int begin, int end, Counters& cnt) const {
+	const std::vector<BVH::BVHNode>& nodes{ m_pBVH->m_nodes };
+	bool isWide{ m_pBVH->isWide() };
+
+	struct Frame {
+		int nodeId;
+		int first;
+		int last;
+	};
+
+	std::vector<int> ids(end - begin);
+	for (int i{}; i < end - begin; ++i)
+		ids[i] = begin + i;
+
+	std::vector<Frame> frames{ { 0, 0, end - begin } };
+
+	while (!frames.empty()) {
+		Frame frame{ frames.back() };
+		frames.pop_back();
+
+		const BVH::BVHNode& node{ nodes[frame.nodeId] };
+
+		++cnt.nodes;
+		if (cnt.pVisits)
+			std::atomic_ref<unsigned>(cnt.pVisits[frame.nodeId]).fetch_add(1, std::memory_order_relaxed);
+		if (cnt.pCache)
+			cnt.pCache->touch(&node, sizeof(BVH::BVHNode));
+
+		// candidates from parent against current t
+		int activeCnt{ filterStream(stream, ids.data() + frame.first, frame.last - frame.first, node.bb) };
+		frame.last = frame.first + activeCnt;
+
+		if (!activeCnt || node.leftCntPar.y) {
+			if (activeCnt)
+				intersectStreamLeaf(stream, ids.data() + frame.first, activeCnt, node.leftCntPar.x, node.leftCntPar.y, cnt);
+			ids.resize(frame.first);
+			continue;
+		}
+
+		// children ordered by first active ray, farthest pushed first
+		Ray ray{ stream.ray(ids[frame.first]) };
+		std::pair<int, float> childs[4]{};
+		int childsCnt{ isWide ? node.leftCntPar.w : 2 };
+		for (int i{}; i < childsCnt; ++i) {
+			int child{ node.leftCntPar.x + i };
+			childs[i] = { child, intersectAABB(ray, nodes[child].bb, stream.tmin[ids[frame.first]], stream.tmax[ids[frame.first]]) };
+		}
+		std::sort(childs, childs + childsCnt, [](const auto& a, const auto& b) { return a.second > b.second; });
+
+		// farthest reuses parent segment, others get copies
+		ids.resize(frame.last);
+		frames.push_back({ childs[0].first, frame.first, frame.last });
+		// copied by index since resize may reallocate source segment
+		ids.resize(frame.last + static_cast<size_t>(childsCnt - 1) * activeCnt);
+		for (int i{ 1 }; i < childsCnt; ++i) {
+			int first{ frame.last + (i - 1) * activeCnt };
+			std::copy_n(ids.data() + frame.first, activeCnt, ids.data() + first);
+			frames.push_back({ childs[i].first, first, first + activeCnt });
+		}
+	}
+}
+
+// primary rays in scanline order, generation is not timed
+CPUTracer::Stats CPUTracer::traceFrameStream(const Matrix& pvInv, const Vector4& whnf) {
+	int width{ static_cast<int>(whnf.x) };
+	int height{ static_cast<int>(whnf.y) };
+
+	RayStream stream{};
+	stream.resize(width * height);
+	Parallel::forEach(0, height, [&](int y) {
+		for (int x{}; x < width; ++x)
+			stream.set(y * width + x, generateRay(pvInv, whnf, x + .5f, y + .5f), whnf.z, whnf.w);
+	});
+
+	return intersect(stream);
+}
+
+CPUTracer::Stats CPUTracer::intersect(RayStream& stream) {
+	prepare();
+
+	int chunksCnt{ (stream.size() + m_streamChunk - 1) / m_streamChunk };
+	std::vector<Stats> chunks(chunksCnt);
+
+	m_timer.start();
+
+	Parallel::forEach(0, chunksCnt, [&](int c) {
+		CacheModel cache{};
+		Counters cnt{ .pCache{ m_simulateCache ? &cache : nullptr } };
+
+		int begin{ c * m_streamChunk };
+		int end{ std::min<int>(stream.size(), begin + m_streamChunk) };
+		intersectStream(stream, begin, end, cnt);
+
+		for (int i{ begin }; i < end; ++i)
+			chunks[c].hits += stream.tId[i] >= 0;
+
+		chunks[c].rays = end - begin;
+		chunks[c].nodesVisited = cnt.nodes;
+		chunks[c].primsTested = cnt.prims;
+		chunks[c].cacheMisses = cache.misses;
+	});
+
+	m_timer.stop();
+
+	return merge(chunks, m_timer.getTime());
+}
+
+std::pair<CPUTracer::Stats, CPUTracer::Stats> CPUTracer::benchSecondary(const Matrix& pvInv, const Vector4& whnf) {
+	prepare();
+
+	int width{ static_cast<int>(whnf.x) };
+	int height{ static_cast<int>(whnf.y) };
+
+	// cosine weighted bounce of every primary hit
+	std::vector<std::vector<Ray>> rows(height);
+	Parallel::forEach(0, height, [&](int y) {
+		std::mt19937 rng{ static_cast<unsigned>(y) };
+		std::uniform_real_distribution<float> uniform{};
+
+		Counters cnt{};
+		for (int x{}; x < width; ++x) {
+			Ray ray{ generateRay(pvInv, whnf, x + .5f, y + .5f) };
+			Intsec best{ intersect(ray, whnf.z, whnf.w, cnt) };
+			if (best.tId < 0)
+				continue;
+
+			Vector3 n{ normal(best.tId) };
+			if (0.f < n.Dot({ ray.dir.x, ray.dir.y, ray.dir.z }))
+				n = -n;
+
+			// tangent frame around normal
+			Vector3 t{ std::abs(n.x) > .9f ? Vector3{ 0.f, 1.f, 0.f } : Vector3{ 1.f, 0.f, 0.f } };
+			Vector3 b{ n.Cross(t) };
+			b.Normalize();
+			t = b.Cross(n);
+
+			float r{ std::sqrt(uniform(rng)) };
+			float phi{ XM_2PI * uniform(rng) };
+			Vector3 dir{ t * (r * std::cos(phi)) + b * (r * std::sin(phi)) + n * std::sqrt(std::max<float>(0.f, 1.f - r * r)) };
+
+			Ray bounce{};
+			bounce.orig = ray.orig + best.t * ray.dir;
+			bounce.orig.w = 1.f;
+			bounce.dir = { dir.x, dir.y, dir.z, 0.f };
+			bounce.invDir = { 1.f / dir.x, 1.f / dir.y, 1.f / dir.z, 0.f };
+
+			rows[y].push_back(bounce);
+		}
+	});
+
+	RayStream stream{};
+	for (const auto& row : rows) {
+		int first{ stream.size() };
+		stream.resize(first + static_cast<int>(row.size()));
+		for (int i{}; i < static_cast<int>(row.size()); ++i)
+			stream.set(first + i, row[i], 1e-4f, whnf.w);
+	}
+
+	// same rays one by one
+	int chunksCnt{ (stream.size() + 255) / 256 };
+	std::vector<Stats> chunks(chunksCnt);
+
+	m_timer.start();
+
+	Parallel::forEach(0, chunksCnt, [&](int c) {
+		CacheModel cache{};
+		Counters cnt{ .pCache{ m_simulateCache ? &cache : nullptr } };
+
+		int last{ std::min<int>(stream.size(), (c + 1) * 256) };
+		for (int i{ c * 256 }; i < last; ++i)
+			chunks[c].hits += intersect(stream.ray(i), stream.tmin[i], stream.tmax[i], cnt).tId >= 0;
+
+		chunks[c].rays = last - c * 256;
+		chunks[c].nodesVisited = cnt.nodes;
+		chunks[c].primsTested = cnt.prims;
+		chunks[c].cacheMisses = cache.misses;
+	});
+
+	m_timer.stop();
+
+	Stats single{ merge(chunks, m_timer.getTime()) };
+	Stats streamed{ intersect(stream) };
+
+	return { single, streamed };
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+#include "framework.h"
+
+#include <cstdint>
+#include <vector>
+#include <emmintrin.h>
+
+#include "BVH.h"
+#include "MeshView.h"
+#include "Timer.h"
+
+// per ray traversal counters, compiled in only if TRACER_STATS is defined
+#ifdef TRACER_STATS
+#define TRACER_STAT(expr) expr
+#else
+#define TRACER_STAT(expr)
+#endif
+
+class BVH;
+
+class CPUTracer {
+	// headless micro benchmarks call private kernels
+	friend class KernelBench;
+
+public:
+	struct Ray {
+		DirectX::SimpleMath::Vector4 orig{};
+		DirectX::SimpleMath::Vector4 dir{};
+		DirectX::SimpleMath::Vector4 invDir{};
+	};
+
+	struct Intsec {
+		int tId{ -1 };
+		float t{};
+		float u{ -1.f };
+		float v{ -1.f };
+	};
+
+	// any hit query over (tmin, tmax)
+	struct OcclusionQuery {
+		Ray ray{};
+		float tmin{};
+		float tmax{};
+	};
+
+	// SoA batch of rays for stream traversal
+	struct RayStream {
+		std::vector<float> ox{}, oy{}, oz{};
+		std::vector<float> dx{}, dy{}, dz{};
+		std::vector<float> ix{}, iy{}, iz{};
+		std::vector<float> tmin{}, tmax{};
+		std::vector<int> tId{};
+
+		int size() const {
+			return static_cast<int>(tId.size());
+		}
+
+		void resize(int n) {
+			for (std::vector<float>* v : { &ox, &oy, &oz, &dx, &dy, &dz, &ix, &iy, &iz, &tmin, &tmax })
+				v->resize(n);
+			tId.resize(n, -1);
+		}
+
+		void set(int i, const Ray& ray, float rayTmin, float rayTmax) {
+			ox[i] = ray.orig.x;
+			oy[i] = ray.orig.y;
+			oz[i] = ray.orig.z;
+			dx[i] = ray.dir.x;
+			dy[i] = ray.dir.y;
+			dz[i] = ray.dir.z;
+			ix[i] = ray.invDir.x;
+			iy[i] = ray.invDir.y;
+			iz[i] = ray.invDir.z;
+			tmin[i] = rayTmin;
+			tmax[i] = rayTmax;
+			tId[i] = -1;
+		}
+
+		Ray ray(int i) const {
+			return {
+				{ ox[i], oy[i], oz[i], 1.f },
+				{ dx[i], dy[i], dz[i], 0.f },
+				{ ix[i], iy[i], iz[i], 0.f }
+			};
+		}
+	};
+
+	struct Stats {
+		double timeMs{};
+		double mraysPerSec{};
+		long long rays{};
+		long long hits{};
+		long long nodesVisited{};
+		long long primsTested{};
+		long long cacheMisses{};
+	};
+
+	struct RayStats {
+		int nodes{};
+		int boxes{};
+		int tris{};
+		// max stack size or trail level for stackless traversal
+		int depth{};
+		int iters{};
+	};
+
+#ifdef TRACER_STATS
+	static constexpr bool IsRayStatsOn{ true };
+#else
+	static constexpr bool IsRayStatsOn{ false };
+#endif
+
+	// same cap as stackless loop in RayTracingCS
+	static constexpr int MaxStacklessIters{ 10000 };
+
+private:
+	static constexpr int StackSize{ 1024 };
+
+	// direct-mapped model of 32 KB L1 with 64 byte lines
+	struct CacheModel {
+		static constexpr int LinesCnt{ 512 };
+
+		uintptr_t tags[LinesCnt]{};
+		long long misses{};
+
+		void touch(const void* ptr, size_t size) {
+			uintptr_t first{ reinterpret_cast<uintptr_t>(ptr) >> 6 };
+			uintptr_t last{ (reinterpret_cast<uintptr_t>(ptr) + size - 1) >> 6 };
+
+			for (uintptr_t line{ first }; line <= last; ++line) {
+				uintptr_t& tag{ tags[line % LinesCnt] };
+				if (tag != line + 1) {
+					tag = line + 1;
+					++misses;
+				}
+			}
+		}
+	};
+
+	// per ray batch counters
+	struct Counters {
+		long long nodes{};
+		long long prims{};
+		CacheModel* pCache{};
+		unsigned* pVisits{};
+#ifdef TRACER_STATS
+		RayStats ray{};
+#endif
+	};
+
+	// 8x8 tile of primary rays in SoA layout, lanes past cnt are inactive
+	struct alignas(16) Packet {
+		static constexpr int Size{ 64 };
+		static constexpr int TileSize{ 8 };
+
+		float ox[Size], oy[Size], oz[Size];
+		float dx[Size], dy[Size], dz[Size];
+		float ix[Size], iy[Size], iz[Size];
+		float tmax[Size];
+		int tId[Size];
+		int cnt{};
+
+		// interval bounds for conservative box rejection
+		DirectX::SimpleMath::Vector3 origMin{}, origMax{};
+		DirectX::SimpleMath::Vector3 invMin{}, invMax{};
+		float tmaxMax{};
+
+		Ray ray(int i) const {
+			return {
+				{ ox[i], oy[i], oz[i], 1.f },
+				{ dx[i], dy[i], dz[i], 0.f },
+				{ ix[i], iy[i], iz[i], 0.f }
+			};
+		}
+	};
+
+	BVH* m_pBVH{};
+
+	// world space copy of vertices, rebuilt lazily after model change
+	std::vector<DirectX::SimpleMath::Vector3> m_vertices{};
+	MeshView m_mesh{};
+	DirectX::SimpleMath::Matrix m_modelMatrix{};
+	bool m_isDirty{ true };
+
+	CPUTimer m_timer{};
+
+public:
+	bool m_simulateCache{ true };
+	bool m_countVisits{};
+	// traceFrame walks tree by parent links like RayTracingCS does
+	bool m_isStackless{};
+	// packet falls back to single rays below this many active rays
+	int m_packetMinActive{ 4 };
+	int m_streamChunk{ 4096 };
+	std::vector<unsigned> m_nodeVisits{};
+	// per pixel counters of last traceFrame, empty without TRACER_STATS
+	std::vector<RayStats> m_rayStats{};
+
+	CPUTracer() = delete;
+	CPUTracer(BVH* pBVH) :
+		m_pBVH(pBVH) {}
+
+	void update(const MeshView& mesh, DirectX::SimpleMath::Matrix modelMatrix);
+
+	// same mapping as generateRay in RayTracingCS
+	Ray generateRay(const DirectX::SimpleMath::Matrix& pvInv, const DirectX::SimpleMath::Vector4& whnf, float x, float y) const;
+
+	Intsec intersect(const Ray& ray, float tmin, float tmax);
+
+	// world space geometric normal of triangle, not oriented
+	DirectX::SimpleMath::Vector3 normal(int primId) const;
+
+	Stats traceFrame(const DirectX::SimpleMath::Matrix& pvInv, const DirectX::SimpleMath::Vector4& whnf);
+	Stats traceFramePackets(const DirectX::SimpleMath::Matrix& pvInv, const DirectX::SimpleMath::Vector4& whnf);
+	Stats traceFrameStream(const DirectX::SimpleMath::Matrix& pvInv, const DirectX::SimpleMath::Vector4& whnf);
+
+	// closest hits of whole stream, chunks of m_streamChunk rays run in parallel
+	Stats intersect(RayStream& stream);
+
+	// diffuse bounces of primary hits, traced by single rays and as streams
+	std::pair<Stats, Stats> benchSecondary(const DirectX::SimpleMath::Matrix& pvInv, const DirectX::SimpleMath::Vector4& whnf);
+
+	bool occluded(const Ray& ray, float tmin, float tmax);
+	void occluded(const std::vector<OcclusionQuery>& queries, std::vector<unsigned char>& results);
+	// any hit of whole stream, occluded rays get tId 0
+	Stats occluded(RayStream& stream);
+
+	// shadow rays from primary hits to point light, traced as closest hit and as occlusion
+	std::pair<Stats, Stats> benchShadows(const DirectX::SimpleMath::Matrix& pvInv, const DirectX::SimpleMath::Vector4& whnf, const DirectX::SimpleMath::Vector4& lightPos);
+
+private:
+	static Stats merge(const std::vector<Stats>& parts, double timeMs);
+
+	void prepare();
+
+	float intersectAABB(const Ray& ray, const AABB& bb, float tmin, float tmax) const;
+	Intsec intersectTri(const Ray& ray, const DirectX::SimpleMath::Vector3& v0, const DirectX::SimpleMath::Vector3& e1, const DirectX::SimpleMath::Vector3& e2) const;
+	int loadTri(int primRefId, DirectX::SimpleMath::Vector3& v0, DirectX::SimpleMath::Vector3& e1, DirectX::SimpleMath::Vector3& e2, Counters& cnt) const;
+	Intsec intersectPrim(const Ray& ray, int primRefId, Counters& cnt) const;
+
+	Intsec intersect(const Ray& ray, float tmin, float tmax, Counters& cnt, int rootId = 0) const;
+	Intsec intersectStackless(const Ray& ray, float tmin, float tmax, Counters& cnt) const;
+
+	bool initPacket(Packet& packet, const DirectX::SimpleMath::Matrix& pvInv, const DirectX::SimpleMath::Vector4& whnf, int tileX, int tileY) const;
+	bool packetHitsAABB(const Packet& packet, const AABB& bb, float tmin) const;
+	static __m128 intersectTri4(const __m128 orig[3], const __m128 dir[3], __m128 tmin, __m128 tmax,
+		const DirectX::SimpleMath::Vector3& v0, const DirectX::SimpleMath::Vector3& e1, const DirectX::SimpleMath::Vector3& e2, __m128& t);
+	void intersectPacketLeaf(Packet& packet, int primRefFirst, int primRefCnt, int first, float tmin, Counters& cnt) const;
+	void intersectPacket(Packet& packet, float tmin, Counters& cnt) const;
+
+	int filterStream(const RayStream& stream, int* ids, int idsCnt, const AABB& bb) const;
+	void intersectStreamLeaf(RayStream& stream, const int* ids, int idsCnt, int primRefFirst, int primRefCnt, Counters& cnt) const;
+	// depth first over a stack of frames, each frame holds ids of rays still active in its node
+	void intersectStream(RayStream& stream, int begin, int end, Counters& cnt) const;
+	bool occluded(const Ray& ray, float tmin, float tmax, Counters& cnt) const;
+};
@@ -1,6 +1,9 @@
 #include <charconv>
+#include <cstring>
 
 #include "CSVGeometryLoader.h"
+#include "MappedFile.h"
+#include "Parallel.h"
 
 using namespace DirectX;
 using namespace DirectX::SimpleMath;
@@ -14,10 +17,126 @@ T string_view_to(std::string_view sv) {
 	return num;
 }
 
+namespace {
+	struct Row {
+		int id{};
+		XMFLOAT3 vertex{};
+	};
+
+	// same columns as stream path: row, vertex id, x, y, z, w is ignored
+	bool parseRow(const char* first, const char* last, Row& row) {
+		const char* fields[7]{ first };
+		int fieldsCnt{ 1 };
+		for (const char* p{ first }; fieldsCnt < 7; ++p) {
+			p = static_cast<const char*>(std::memchr(p, ',', last - p));
+			if (!p)
+				break;
+			fields[fieldsCnt++] = p + 1;
+		}
+
+		if (fieldsCnt < 5)
+			return false;
+
+		auto fieldEnd = [&](int i) {
+			return i + 1 < fieldsCnt ? fields[i + 1] - 1 : last;
+		};
+
+		if (std::from_chars(fields[1], fieldEnd(1), row.id).ec == std::errc::invalid_argument || row.id < 0)
+			return false;
+
+		float* coords{ &row.vertex.x };
+		for (int i{}; i < 3; ++i) {
+			if (std::from_chars(fields[2 + i], fieldEnd(2 + i), coords[i]).ec == std::errc::invalid_argument)
+				return false;
+		}
+
+		return true;
+	}
+}
+
 void CSVGeometryLoader::loadFrom(
 	const std::string& filepath,
-	std::vector<DirectX::XMINT4>* pIndices,
-	std::vector<DirectX::SimpleMath::Vector4>* pVertices
+	std::vector<DirectX::XMUINT3>* pIndices,
+	std::vector<DirectX::XMFLOAT3>* pVertices
+) {
+	if (!loadFromMapped(filepath, pIndices, pVertices))
+		loadFromStream(filepath, pIndices, pVertices);
+}
+
+bool CSVGeometryLoader::loadFromMapped(
+	const std::string& filepath,
+	std::vector<DirectX::XMUINT3>* pIndices,
+	std::vector<DirectX::XMFLOAT3>* pVertices
+) {
+	MappedFile file{};
+	if (!file.open(filepath))
+		return false;
+
+	const char* data{ reinterpret_cast<const char*>(file.data()) };
+	size_t size{ file.size() };
+
+	// chunks start right after newline
+	int chunksCnt{ 4 * Parallel::threadsCnt() };
+	std::vector<size_t> bounds(chunksCnt + 1, size);
+	bounds[0] = 0;
+	for (int c{ 1 }; c < chunksCnt; ++c) {
+		size_t pos{ std::max<size_t>(bounds[c - 1], size * c / chunksCnt) };
+		const char* nl{ pos < size ? static_cast<const char*>(std::memchr(data + pos, '\n', size - pos)) : nullptr };
+		bounds[c] = nl ? nl - data + 1 : size;
+	}
+
+	std::vector<std::vector<Row>> chunks(chunksCnt);
+	Parallel::forEach(0, chunksCnt, [&](int c) {
+		std::vector<Row>& rows{ chunks[c] };
+		rows.reserve((bounds[c + 1] - bounds[c]) / 48);
+
+		const char* p{ data + bounds[c] };
+		const char* end{ data + bounds[c + 1] };
+		while (p < end) {
+			const char* nl{ static_cast<const char*>(std::memchr(p, '\n', end - p)) };
+			const char* lineEnd{ nl ? nl : end };
+
+			Row row{};
+			if (parseRow(p, lineEnd, row))
+				rows.push_back(row);
+
+			p = lineEnd + 1;
+		}
+	});
+
+	// merge in file order, every 3 rows are triangle
+	std::vector<int> offsets(chunksCnt + 1);
+	int maxId{ -1 };
+	for (int c{}; c < chunksCnt; ++c) {
+		offsets[c + 1] = offsets[c] + static_cast<int>(chunks[c].size());
+		for (const Row& row : chunks[c])
+			maxId = std::max<int>(maxId, row.id);
+	}
+
+	pIndices->assign(offsets[chunksCnt] / 3, XMUINT3{});
+	pVertices->assign(static_cast<size_t>(maxId + 1), XMFLOAT3{});
+
+	Parallel::forEach(0, chunksCnt, [&](int c) {
+		for (int i{}; i < static_cast<int>(chunks[c].size()); ++i) {
+			int rowId{ offsets[c] + i };
+			if (rowId / 3 < static_cast<int>(pIndices->size()))
+				(&(*pIndices)[rowId / 3].x)[rowId % 3] = chunks[c][i].id;
+		}
+	});
+
+	// same id may repeat across chunks, serial file order keeps last row as stream path does
+	for (const std::vector<Row>& rows : chunks) {
+		for (const Row& row : rows)
+			(*pVertices)[row.id] = row.vertex;
+	}
+
+	return true;
+}
+
+void CSVGeometryLoader::loadFromStream(
+	const std::string& filepath,
+	std::vector<DirectX::XMUINT3>* pIndices,
+	std::vector<DirectX::XMFLOAT3>* pVertices
 ) {
 	std::ifstream file{ filepath };
 
@@ -28,19 +147,18 @@ void CSVGeometryLoader::loadFrom(
 	pVertices->resize(0);
 
 
-	XMINT4 triangle{};
+	XMUINT3 triangle{};
 	int tv{};
 	int iter{};
 	for (auto& row : CSVIterator(file)) {
 		int id{};
-		Vector4 vertex{};
+		XMFLOAT3 vertex{};
 		try {
 			id = string_view_to<int>(row[1]);
 			vertex = {
 				string_view_to<float>(row[2]),
 				string_view_to<float>(row[3]),
-				string_view_to<float>(row[4]),
-				string_view_to<float>(row[5])
+				string_view_to<float>(row[4])
 			};
 		}
 		catch (const std::invalid_argument&) {
@@ -58,7 +176,6 @@ void CSVGeometryLoader::loadFrom(
 			break;
 		case 2:
 			triangle.z = id;
-			triangle.w = 0;
 			tv = 0;
 			pIndices->push_back(triangle);
 		}
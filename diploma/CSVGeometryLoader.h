@@ -4,9 +4,22 @@
 #include "CSVIterator.h"
 
 struct CSVGeometryLoader {
+	// mapped file is parsed by chunks in parallel, stream is fallback
 	static void loadFrom(
 		const std::string& filepath,
-		std::vector<DirectX::XMINT4>* indices,
-		std::vector<DirectX::SimpleMath::Vector4>* vertices
+		std::vector<DirectX::XMUINT3>* indices,
+		std::vector<DirectX::XMFLOAT3>* vertices
+	);
+
+	static bool loadFromMapped(
+		const std::string& filepath,
+		std::vector<DirectX::XMUINT3>* indices,
+		std::vector<DirectX::XMFLOAT3>* vertices
+	);
+
+	static void loadFromStream(
+		const std::string& filepath,
+		std::vector<DirectX::XMUINT3>* indices,
+		std::vector<DirectX::XMFLOAT3>* vertices
 	);
 };
\ No newline at end of file
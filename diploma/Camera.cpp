@@ -3,6 +3,17 @@
 using namespace DirectX;
 using namespace DirectX::SimpleMath;
 
+Camera::State Camera::getState() {
+    return { m_poi, m_r, m_angZ, m_angY };
+}
+
+void Camera::setState(const State& state) {
+    m_poi = state.poi;
+    m_r = state.r;
+    m_angZ = state.angZ;
+    m_angY = state.angY;
+}
+
 void Camera::rotate(float dx, float dy) {
     m_angZ -= dx * ROTATE_COEF;
     m_angY += dy * ROTATE_COEF;
@@ -48,6 +59,19 @@ Vector3 Camera::getPosition() {
     return m_poi + m_r * getDir();
 }
 
+Matrix Camera::getViewMatrix() {
+    return XMMatrixLookAtLH(getPosition(), getPoi(), getUp());
+}
+
+Matrix Camera::getProjMatrix(float fov, float width, float height, float nearZ, float farZ) {
+    return XMMatrixPerspectiveLH(
+        2 * nearZ * tanf(fov / 2),
+        2 * nearZ * tanf(fov / 2) * height / width,
+        nearZ,
+        farZ
+    );
+}
+
 void Camera::getDirections(Vector3& forward, Vector3& right) {
     auto dir{ getDir() };
     auto up{ getUp() };
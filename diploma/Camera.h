@@ -18,6 +18,17 @@ class Camera {
 	float m_dRight{};
 
 public:
+	// everything defining view, recorded per frame in camera paths
+	struct State {
+		DirectX::SimpleMath::Vector3 poi{};
+		float r{};
+		float angZ{};
+		float angY{};
+	};
+
+	State getState();
+	void setState(const State& state);
+
 	void rotate(float dx, float dy);
 	void zoom(float delta);
 	void moveForward(float dir = 1.f);
@@ -29,6 +40,9 @@ public:
 	DirectX::SimpleMath::Vector3 getUp();
 	DirectX::SimpleMath::Vector3 getPosition();
 
+	DirectX::SimpleMath::Matrix getViewMatrix();
+	static DirectX::SimpleMath::Matrix getProjMatrix(float fov, float width, float height, float nearZ, float farZ);
+
 private:
 	void getDirections(DirectX::SimpleMath::Vector3& forward, DirectX::SimpleMath::Vector3& right);
 };
\ No newline at end of file
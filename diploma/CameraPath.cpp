@@ -0,0 +1,74 @@
+#include "CameraPath.h"
+
+#include <fstream>
+#include <iomanip>
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+void CameraPath::clear(const Projection& proj) {
+	m_proj = proj;
+	m_frames.clear();
+}
+
+void CameraPath::record(const Camera::State& state) {
+	m_frames.push_back(state);
+}
+
+int CameraPath::size() const {
+	return static_cast<int>(m_frames.size());
+}
+
+const Camera::State& CameraPath::frame(int frameId) const {
+	return m_frames[frameId];
+}
+
+const CameraPath::Projection& CameraPath::projection() const {
+	return m_proj;
+}
+
+Matrix CameraPath::pvInv(int frameId) const {
+	Camera camera{};
+	camera.setState(m_frames[frameId]);
+
+	Matrix v{ camera.getViewMatrix() };
+	Matrix p{ Camera::getProjMatrix(m_proj.fov, m_proj.width, m_proj.height, m_proj.nearZ, m_proj.farZ) };
+
+	Matrix res{};
+	(v * p).Invert(res);
+	return res;
+}
+
+Vector4 CameraPath::whnf() const {
+	return { m_proj.width, m_proj.height, m_proj.nearZ, m_proj.farZ };
+}
+
+bool CameraPath::save(const std::string& path) const {
+	std::ofstream file{ path };
+	if (!file)
+		return false;
+
+	// enough digits for floats to read back exactly
+	file << std::setprecision(9);
+	file << m_proj.width << ' ' << m_proj.height << ' ' << m_proj.fov << ' ' << m_proj.nearZ << ' ' << m_proj.farZ << '\n';
+	for (const Camera::State& state : m_frames)
+		file << state.poi.x << ' ' << state.poi.y << ' ' << state.poi.z << ' ' << state.r << ' ' << state.angZ << ' ' << state.angY << '\n';
+
+	return static_cast<bool>(file);
+}
+
+bool CameraPath::load(const std::string& path) {
+	std::ifstream file{ path };
+	if (!file)
+		return false;
+
+	Projection proj{};
+	if (!(file >> proj.width >> proj.height >> proj.fov >> proj.nearZ >> proj.farZ))
+		return false;
+
+	clear(proj);
+	for (Camera::State state{}; file >> state.poi.x >> state.poi.y >> state.poi.z >> state.r >> state.angZ >> state.angY;)
+		m_frames.push_back(state);
+
+	return !m_frames.empty();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "framework.h"
+
+#include "Camera.h"
+
+// camera states recorded per frame together with projection they were shown with
+class CameraPath {
+public:
+	struct Projection {
+		float width{ 16.f };
+		float height{ 9.f };
+		float fov{ DirectX::XM_PI / 3.f };
+		float nearZ{ 0.1f };
+		float farZ{ 100.f };
+	};
+
+private:
+	Projection m_proj{};
+	std::vector<Camera::State> m_frames{};
+
+public:
+	void clear(const Projection& proj);
+	void record(const Camera::State& state);
+
+	int size() const;
+	const Camera::State& frame(int frameId) const;
+	const Projection& projection() const;
+
+	// same matrices and ray mapping as Renderer::update feeds to ray tracing
+	DirectX::SimpleMath::Matrix pvInv(int frameId) const;
+	DirectX::SimpleMath::Vector4 whnf() const;
+
+	// text file, projection on first line and one state per line after
+	bool save(const std::string& path) const;
+	bool load(const std::string& path);
+};
@@ -7,7 +7,8 @@
 #include "imgui_impl_dx11.h"
 #include "imgui_impl_win32.h"
 
-#include "CSVGeometryLoader.h"
+#include "MeshFile.h"
+#include "SceneGenerator.h"
 
 using namespace DirectX;
 using namespace DirectX::SimpleMath;
@@ -28,20 +29,35 @@ HRESULT Geometry::init(ID3D11Texture2D* tex) {
 	// upload geometry
 	{
 		// main - cube 11715 sponza sponzastructure grass hairball
-		CSVGeometryLoader::loadFrom("sponzastructure.csv", &m_indices, &m_vertices);
+		// binary mesh is mapped, csv, obj or ply is converted next to it on first run
+		// generated scenes like "gen:teapot:100000" are built in memory, see SceneGenerator
+		std::string name{ "sponzastructure" };
+		if (SceneGenerator::isSpec(name)) {
+			if (!m_mesh.load(name))
+				throw std::exception("Failed to generate mesh");
+		}
+		else if (!m_mesh.load(name + ".mesh")) {
+			if (!m_mesh.load(name + ".csv") && !m_mesh.load(name + ".obj") && !m_mesh.load(name + ".ply")) {
+				throw std::exception("Failed to load mesh");
+			}
+			MeshFile::save(name + ".mesh", m_mesh.view());
+		}
 	}
 
-	// create indices buffer
+	const MeshView& mesh{ m_mesh.view() };
+
+	// create indices buffer, typed so 16 and 32 bit indices share one shader path
 	{
+		// 16 bit index arrays are padded to 4 bytes both in memory and in .mesh
+		UINT byteWidth{ static_cast<UINT>((mesh.indicesSize() + 3) & ~static_cast<size_t>(3)) };
+
 		D3D11_BUFFER_DESC desc{
-			.ByteWidth{ static_cast<UINT>(m_indices.size() * sizeof(XMINT4)) },
+			.ByteWidth{ byteWidth },
 			.Usage{ D3D11_USAGE_IMMUTABLE },
-			.BindFlags{ D3D11_BIND_SHADER_RESOURCE },
-			.MiscFlags{ D3D11_RESOURCE_MISC_BUFFER_STRUCTURED },
-			.StructureByteStride{ sizeof(XMINT4) }
+			.BindFlags{ D3D11_BIND_SHADER_RESOURCE }
 		};
 
-		D3D11_SUBRESOURCE_DATA data{ m_indices.data(), m_indices.size() * sizeof(XMINT4)};
+		D3D11_SUBRESOURCE_DATA data{ mesh.pIndices, byteWidth };
 
 		hr = m_pDevice->CreateBuffer(&desc, &data, &m_pIndexBuffer);
 		THROW_IF_FAILED(hr);
@@ -50,11 +66,11 @@ HRESULT Geometry::init(ID3D11Texture2D* tex) {
 		THROW_IF_FAILED(hr);
 
 		D3D11_SHADER_RESOURCE_VIEW_DESC descSRV{
-			.Format{ DXGI_FORMAT_UNKNOWN },
+			.Format{ mesh.indexSize == sizeof(uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT },
 			.ViewDimension{ D3D11_SRV_DIMENSION_BUFFER },
 			.Buffer{
 				.FirstElement{ 0 },
-				.NumElements{ static_cast<UINT>(m_indices.size()) }
+				.NumElements{ static_cast<UINT>(3 * mesh.trisCnt) }
 			}
 		};
 
@@ -68,14 +84,14 @@ HRESULT Geometry::init(ID3D11Texture2D* tex) {
 	// create vertices buffer
 	{
 		D3D11_BUFFER_DESC desc{
-			.ByteWidth{ static_cast<UINT>(m_vertices.size() * sizeof(Vector4)) },
+			.ByteWidth{ static_cast<UINT>(mesh.verticesSize()) },
 			.Usage{ D3D11_USAGE_IMMUTABLE },
 			.BindFlags{ D3D11_BIND_SHADER_RESOURCE },
 			.MiscFlags{ D3D11_RESOURCE_MISC_BUFFER_STRUCTURED },
-			.StructureByteStride{ sizeof(Vector4) }
+			.StructureByteStride{ sizeof(XMFLOAT3) }
 		};
 
-		D3D11_SUBRESOURCE_DATA data{ m_vertices.data(), m_vertices.size() * sizeof(Vector4)};
+		D3D11_SUBRESOURCE_DATA data{ mesh.pVertices, static_cast<UINT>(mesh.verticesSize()) };
 
 		hr = m_pDevice->CreateBuffer(&desc, &data, &m_pVertexBuffer);
 		THROW_IF_FAILED(hr);
@@ -88,7 +104,7 @@ HRESULT Geometry::init(ID3D11Texture2D* tex) {
 			.ViewDimension{ D3D11_SRV_DIMENSION_BUFFER },
 			.Buffer{
 				.FirstElement{ 0 },
-				.NumElements{ static_cast<UINT>(m_vertices.size()) }
+				.NumElements{ static_cast<UINT>(mesh.verticesCnt) }
 			}
 		};
 
@@ -101,7 +117,7 @@ HRESULT Geometry::init(ID3D11Texture2D* tex) {
 
 	// create model const buffer
 	{
-		m_modelBuffer.primsCnt.x = m_indices.size();
+		m_modelBuffer.primsCnt.x = mesh.trisCnt;
 		m_modelBuffer.updateMatrices();
 
 		D3D11_BUFFER_DESC desc{
@@ -140,7 +156,11 @@ HRESULT Geometry::init(ID3D11Texture2D* tex) {
 
 	resizeUAV(tex);
 
-	m_pBVH = new BVH(m_pDevice, m_pDeviceContext, m_indices.size());
+	m_pBVH = new BVH(m_pDevice, m_pDeviceContext, mesh.trisCnt);
+	// optional, written by headless calibrate
+	m_pBVH->loadParams("bvh.params");
+	m_pCPUTracer = new CPUTracer(m_pBVH);
+	m_pWavefront = new WavefrontRenderer(m_pCPUTracer);
 
 	// timers init
 	m_pGPUTimer = new GPUTimer(m_pDevice, m_pDeviceContext);
@@ -177,10 +197,19 @@ void Geometry::update(float delta, bool isRotate) {
 void Geometry::updateBVH() {
 	m_pCPUTimer->start();
 
-	m_pBVH->build(m_vertices.data(), m_vertices.size(), m_indices.data(), m_indices.size(), m_modelBuffer.mModel);
+	const MeshView& mesh{ m_mesh.view() };
+	m_pBVH->build(mesh, m_modelBuffer.mModel);
 
 	m_pCPUTimer->stop();
 
+	m_pCPUTracer->update(mesh, m_modelBuffer.mModel);
+
+	// leafs read flat triangles instead of indices and vertices
+	if (m_modelBuffer.primsCnt.y != static_cast<int>(m_pBVH->isFlatTris())) {
+		m_modelBuffer.primsCnt.y = m_pBVH->isFlatTris();
+		m_pDeviceContext->UpdateSubresource(m_pModelBuffer, 0, nullptr, &m_modelBuffer, 0, 0);
+	}
+
 	m_pBVH->updateRenderBVH();
 	m_pBVH->updateBuffers();
 }
@@ -201,11 +230,24 @@ void Geometry::rayTracing(ID3D11Buffer* m_pSBuf, ID3D11Buffer* m_pRTBuf, int w,
 		m_pModelBuffer,
 		m_pRTBuf
 	};
+	// highlight bits are read only while prims are highlighted
+	if (m_modelBuffer.primsCnt.z != static_cast<int>(m_pBVH->isPrimHighlights())) {
+		m_modelBuffer.primsCnt.z = m_pBVH->isPrimHighlights();
+		m_pDeviceContext->UpdateSubresource(m_pModelBuffer, 0, nullptr, &m_modelBuffer, 0, 0);
+	}
+
 	m_pDeviceContext->CSSetConstantBuffers(0, 2, constBuffers);
 
 	// bind srv
-	ID3D11ShaderResourceView* srvBuffers[]{ m_pVertexBufferSRV, m_pIndexBufferSRV, m_pBVH->getPrimIdsBufferSRV(), m_pBVH->getBVHBufferSRV()};
-	m_pDeviceContext->CSSetShaderResources(0, 4, srvBuffers);
+	ID3D11ShaderResourceView* srvBuffers[]{
+		m_pVertexBufferSRV,
+		m_pIndexBufferSRV,
+		m_pBVH->getPrimIdsBufferSRV(),
+		m_pBVH->getBVHBufferSRV(),
+		m_pBVH->getFlatTrisBufferSRV(),
+		m_pBVH->getPrimHighlightsBufferSRV()
+	};
+	m_pDeviceContext->CSSetShaderResources(0, 6, srvBuffers);
 
 	// unbind rtv
 	ID3D11RenderTargetView* nullRtv{};
@@ -229,3 +271,39 @@ void Geometry::rayTracing(ID3D11Buffer* m_pSBuf, ID3D11Buffer* m_pRTBuf, int w,
 void Geometry::renderBVH(ID3D11SamplerState* pSampler, ID3D11Buffer* pSceneBuffer) {
 	m_pBVH->render(pSampler, pSceneBuffer);
 }
+
+CPUTracer::Stats Geometry::cpuTracing(const Matrix& pvInv, const Vector4& whnf) {
+	return m_pCPUTracer->traceFrame(pvInv, whnf);
+}
+
+void Geometry::relayoutByVisits(const Matrix& pvInv, const Vector4& whnf) {
+	m_pCPUTracer->m_countVisits = true;
+	m_pCPUTracer->traceFrame(pvInv, whnf);
+	m_pCPUTracer->m_countVisits = false;
+
+	m_pBVH->setLayout(3);
+	m_pBVH->reorderNodes(m_pCPUTracer->m_nodeVisits);
+
+	m_pBVH->updateRenderBVH();
+	m_pBVH->updateBuffers();
+}
+
+std::vector<CPUTracer::Stats> Geometry::compareLayouts(const Matrix& pvInv, const Vector4& whnf) {
+	int layout{ m_pBVH->getLayout() };
+
+	std::vector<CPUTracer::Stats> stats{};
+	for (int alg{}; alg < 4; ++alg) {
+		m_pBVH->setLayout(alg);
+		updateBVH();
+
+		if (alg == 3)
+			relayoutByVisits(pvInv, whnf);
+
+		stats.push_back(cpuTracing(pvInv, whnf));
+	}
+
+	m_pBVH->setLayout(layout);
+	updateBVH();
+
+	return stats;
+}
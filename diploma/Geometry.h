@@ -9,6 +9,9 @@
 #include "AABB.h"
 #include "Timer.h"
 #include "BVH.h"
+#include "CPUTracer.h"
+#include "MeshFile.h"
+#include "WavefrontRenderer.h"
 //#include "BVHRenderer.h"
 
 class Renderer;
@@ -17,6 +20,8 @@ struct AABB;
 class CPUTimer;
 class GPUTimer;
 class BVH;
+class CPUTracer;
+class WavefrontRenderer;
 //class BVHRenderer;
 
 #define LIMIT_V 1013
@@ -26,13 +31,14 @@ class Geometry {
 	ID3D11Device* m_pDevice{};
 	ID3D11DeviceContext* m_pDeviceContext{};
 
+	// mapped binary mesh or parsed csv
+	MeshFile m_mesh{};
+
 	// index buffer
-	std::vector<DirectX::XMINT4> m_indices{};
 	ID3D11Buffer* m_pIndexBuffer{};
 	ID3D11ShaderResourceView* m_pIndexBufferSRV{};
 
 	// vertices
-	std::vector<DirectX::SimpleMath::Vector4> m_vertices{};
 	ID3D11Buffer* m_pVertexBuffer{};
 	ID3D11ShaderResourceView* m_pVertexBufferSRV{};
 
@@ -56,6 +62,8 @@ class Geometry {
 
 public:
 	BVH* m_pBVH{};
+	CPUTracer* m_pCPUTracer{};
+	WavefrontRenderer* m_pWavefront{};
 
 	Geometry() = delete;
 	Geometry(ID3D11Device* device, ID3D11DeviceContext* deviceContext) :
@@ -75,4 +83,8 @@ public:
 	void rayTracing(ID3D11Buffer* m_pSceneBuffer, ID3D11Buffer* m_pRTBuffer, int width, int height);
 
 	void renderBVH(ID3D11SamplerState* pSampler, ID3D11Buffer* pSceneBuffer);
+
+	CPUTracer::Stats cpuTracing(const DirectX::SimpleMath::Matrix& pvInv, const DirectX::SimpleMath::Vector4& whnf);
+	void relayoutByVisits(const DirectX::SimpleMath::Matrix& pvInv, const DirectX::SimpleMath::Vector4& whnf);
+	std::vector<CPUTracer::Stats> compareLayouts(const DirectX::SimpleMath::Matrix& pvInv, const DirectX::SimpleMath::Vector4& whnf);
 };
@@ -39,6 +39,16 @@ void InputHandler::keyPressed(int keyCode) {
 		renderer->updateBVH();
 		break;
 
+	case 'R':
+	case 'r':
+		renderer->switchCameraRecording();
+		break;
+
+	case 'P':
+	case 'p':
+		renderer->switchCameraPlayback();
+		break;
+
 	default:
 		processMovement(keyCode, 1.f);
 	}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "framework.h"
+
+#include <cstdint>
+
+// read only file mapping
+class MappedFile {
+	HANDLE m_hFile{ INVALID_HANDLE_VALUE };
+	HANDLE m_hMapping{};
+	const uint8_t* m_pData{};
+	size_t m_size{};
+
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	bool open(const std::string& path);
+	void close();
+
+	const uint8_t* data() const;
+	size_t size() const;
+};
@@ -0,0 +1,162 @@
+#include "MeshFile.h"
+
+#include <atomic>
+#include <fstream>
+
+#include "CSVGeometryLoader.h"
+#include "OBJGeometryLoader.h"
+#include "Parallel.h"
+#include "PLYGeometryLoader.h"
+#include "SceneGenerator.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+	uint64_t align(uint64_t offset) {
+		return (offset + MeshFile::Alignment - 1) & ~static_cast<uint64_t>(MeshFile::Alignment - 1);
+	}
+
+	bool hasExtension(const std::string& path, const std::string& ext) {
+		return path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+	}
+}
+
+const MeshView& MeshFile::view() const {
+	return m_view;
+}
+
+bool MeshFile::isBinary(const std::string& path) {
+	return hasExtension(path, ".mesh");
+}
+
+bool MeshFile::load(const std::string& path) {
+	m_view = {};
+	m_file.close();
+	m_indices.clear();
+	m_shortIndices.clear();
+	m_vertices.clear();
+
+	if (isBinary(path))
+		return loadBinary(path);
+	if (SceneGenerator::isSpec(path))
+		return SceneGenerator::generate(path, &m_indices, &m_vertices) && viewParsed();
+	if (hasExtension(path, ".obj") || hasExtension(path, ".ply"))
+		return loadImported(path);
+	return loadCSV(path);
+}
+
+bool MeshFile::loadBinary(const std::string& path) {
+	if (!m_file.open(path) || m_file.size() < sizeof(Header))
+		return false;
+
+	const Header& header{ *reinterpret_cast<const Header*>(m_file.data()) };
+	if (header.magic != Magic || header.version != Version
+		|| (header.indexSize != sizeof(uint16_t) && header.indexSize != sizeof(uint32_t))
+		|| header.vertexStride != sizeof(XMFLOAT3)
+		|| header.indicesOffset % Alignment || header.verticesOffset % Alignment
+		|| header.indicesOffset + 3ull * header.trisCnt * header.indexSize > m_file.size()
+		|| header.verticesOffset + header.verticesCnt * sizeof(XMFLOAT3) > m_file.size()) {
+		m_file.close();
+		return false;
+	}
+
+	m_view = {
+		.pVertices{ reinterpret_cast<const XMFLOAT3*>(m_file.data() + header.verticesOffset) },
+		.verticesCnt{ static_cast<int>(header.verticesCnt) },
+		.pIndices{ m_file.data() + header.indicesOffset },
+		.trisCnt{ static_cast<int>(header.trisCnt) },
+		.indexSize{ static_cast<int>(header.indexSize) }
+	};
+
+	// corrupt or stale file must not lead readers past vertices
+	std::atomic<bool> isValid{ true };
+	Parallel::forEach(0, m_view.trisCnt, [&](int i) {
+		XMUINT3 tri{ m_view.tri(i) };
+		if (tri.x >= header.verticesCnt || tri.y >= header.verticesCnt || tri.z >= header.verticesCnt)
+			isValid = false;
+	}, 4096);
+
+	if (!isValid) {
+		m_view = {};
+		m_file.close();
+		return false;
+	}
+
+	return true;
+}
+
+bool MeshFile::loadCSV(const std::string& path) {
+	CSVGeometryLoader::loadFrom(path, &m_indices, &m_vertices);
+	return viewParsed();
+}
+
+bool MeshFile::loadImported(const std::string& path) {
+	bool isLoaded{
+		hasExtension(path, ".obj")
+			? OBJGeometryLoader::loadFrom(path, &m_indices, &m_vertices)
+			: PLYGeometryLoader::loadFrom(path, &m_indices, &m_vertices)
+	};
+	return isLoaded && viewParsed();
+}
+
+bool MeshFile::viewParsed() {
+	if (m_indices.empty())
+		return false;
+
+	m_view = {
+		.pVertices{ m_vertices.data() },
+		.verticesCnt{ static_cast<int>(m_vertices.size()) },
+		.pIndices{ m_indices.data() },
+		.trisCnt{ static_cast<int>(m_indices.size()) }
+	};
+
+	if (m_vertices.size() > MaxShortIndexVertices)
+		return true;
+
+	m_shortIndices.resize((3 * m_indices.size() + 1) & ~static_cast<size_t>(1));
+	for (size_t i{}; i < m_indices.size(); ++i) {
+		m_shortIndices[3 * i] = static_cast<uint16_t>(m_indices[i].x);
+		m_shortIndices[3 * i + 1] = static_cast<uint16_t>(m_indices[i].y);
+		m_shortIndices[3 * i + 2] = static_cast<uint16_t>(m_indices[i].z);
+	}
+	m_indices.clear();
+	m_indices.shrink_to_fit();
+
+	m_view.pIndices = m_shortIndices.data();
+	m_view.indexSize = sizeof(uint16_t);
+
+	return true;
+}
+
+bool MeshFile::save(const std::string& path, const MeshView& mesh) {
+	Header header{
+		.trisCnt{ static_cast<uint32_t>(mesh.trisCnt) },
+		.verticesCnt{ static_cast<uint32_t>(mesh.verticesCnt) },
+		.indexSize{ static_cast<uint32_t>(mesh.indexSize) }
+	};
+	header.indicesOffset = align(sizeof(Header));
+	header.verticesOffset = align(header.indicesOffset + mesh.indicesSize());
+
+	std::ofstream file{ path, std::ios::binary };
+	if (!file)
+		return false;
+
+	const char zeros[Alignment]{};
+	auto pad = [&](uint64_t offset) {
+		file.write(zeros, offset - static_cast<uint64_t>(file.tellp()));
+	};
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	pad(header.indicesOffset);
+	file.write(static_cast<const char*>(mesh.pIndices), mesh.indicesSize());
+	pad(header.verticesOffset);
+	file.write(reinterpret_cast<const char*>(mesh.pVertices), mesh.verticesSize());
+
+	return static_cast<bool>(file);
+}
+
+bool MeshFile::convert(const std::string& srcPath, const std::string& dstPath) {
+	MeshFile mesh{};
+	return mesh.load(srcPath) && save(dstPath, mesh.view());
+}
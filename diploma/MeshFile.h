@@ -0,0 +1,61 @@
+#pragma once
+
+#include "framework.h"
+
+#include <cstdint>
+
+#include "MappedFile.h"
+#include "MeshView.h"
+
+// binary mesh is mapped and used in place, csv, obj and ply are parsed into own arrays
+class MeshFile {
+public:
+	static constexpr uint32_t Magic{ 0x4853454d }; // "MESH"
+	static constexpr uint32_t Version{ 2 };
+	static constexpr size_t Alignment{ 64 };
+
+	// meshes with at most this many vertices get 16 bit indices
+	static constexpr size_t MaxShortIndexVertices{ 1 << 16 };
+
+	// arrays follow header at aligned offsets
+	struct Header {
+		uint32_t magic{ Magic };
+		uint32_t version{ Version };
+		uint32_t trisCnt{};
+		uint32_t verticesCnt{};
+		uint64_t indicesOffset{};
+		uint64_t verticesOffset{};
+		uint32_t indexSize{ sizeof(uint32_t) };
+		uint32_t vertexStride{ sizeof(DirectX::XMFLOAT3) };
+		uint8_t reserved[24]{};
+	};
+	static_assert(sizeof(Header) == Alignment);
+
+private:
+	MappedFile m_file{};
+	std::vector<DirectX::XMUINT3> m_indices{};
+	// padded to 4 bytes so it can be uploaded as is
+	std::vector<uint16_t> m_shortIndices{};
+	std::vector<DirectX::XMFLOAT3> m_vertices{};
+
+	MeshView m_view{};
+
+public:
+	// .mesh files are mapped, .obj and .ply are imported, "gen:" names are generated, others are read as csv
+	bool load(const std::string& path);
+	const MeshView& view() const;
+
+	static bool isBinary(const std::string& path);
+	static bool save(const std::string& path, const MeshView& mesh);
+
+	// converts csv, obj or ply into binary mesh
+	static bool convert(const std::string& srcPath, const std::string& dstPath);
+
+private:
+	bool loadBinary(const std::string& path);
+	bool loadCSV(const std::string& path);
+	bool loadImported(const std::string& path);
+
+	// builds view over parsed arrays, narrowing indices for small meshes
+	bool viewParsed();
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "framework.h"
+
+#include <cstdint>
+
+// float3 positions and 3 indices per triangle, indices are 16 bit for small meshes
+struct MeshView {
+	const DirectX::XMFLOAT3* pVertices{};
+	int verticesCnt{};
+	const void* pIndices{};
+	int trisCnt{};
+	int indexSize{ sizeof(uint32_t) };
+
+	const void* triData(int triId) const {
+		return static_cast<const uint8_t*>(pIndices) + 3ull * indexSize * triId;
+	}
+
+	DirectX::XMUINT3 tri(int triId) const {
+		if (indexSize == sizeof(uint16_t)) {
+			const uint16_t* ids{ static_cast<const uint16_t*>(triData(triId)) };
+			return { ids[0], ids[1], ids[2] };
+		}
+
+		const uint32_t* ids{ static_cast<const uint32_t*>(triData(triId)) };
+		return { ids[0], ids[1], ids[2] };
+	}
+
+	DirectX::SimpleMath::Vector4 vertex(uint32_t id) const {
+		return { pVertices[id].x, pVertices[id].y, pVertices[id].z, 1.f };
+	}
+
+	size_t indicesSize() const {
+		return 3ull * indexSize * trisCnt;
+	}
+
+	size_t verticesSize() const {
+		return sizeof(DirectX::XMFLOAT3) * verticesCnt;
+	}
+};
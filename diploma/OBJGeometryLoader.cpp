@@ -0,0 +1,161 @@
+#include "OBJGeometryLoader.h"
+
+#include <atomic>
+#include <charconv>
+#include <cstring>
+
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "VertexWelder.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+	bool isSpace(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	const char* skipSpaces(const char* p, const char* end) {
+		while (p < end && isSpace(*p))
+			++p;
+		return p;
+	}
+
+	const char* skipToken(const char* p, const char* end) {
+		while (p < end && !isSpace(*p))
+			++p;
+		return p;
+	}
+
+	// "v" or "f" followed by whitespace
+	char lineType(const char* p, const char* end) {
+		if (end - p < 2 || !isSpace(p[1]))
+			return 0;
+		return *p == 'v' || *p == 'f' ? *p : 0;
+	}
+
+	// calls f(type, first, last) with keyword stripped for every v and f line
+	template <typename F>
+	void forEachLine(const char* p, const char* end, F f) {
+		while (p < end) {
+			const char* nl{ static_cast<const char*>(std::memchr(p, '\n', end - p)) };
+			const char* lineEnd{ nl ? nl : end };
+
+			const char* first{ skipSpaces(p, lineEnd) };
+			if (char type{ lineType(first, lineEnd) })
+				f(type, first + 1, lineEnd);
+
+			p = lineEnd + 1;
+		}
+	}
+
+	int faceVerticesCnt(const char* p, const char* end) {
+		int cnt{};
+		for (p = skipSpaces(p, end); p < end; p = skipSpaces(skipToken(p, end), end))
+			++cnt;
+		return cnt;
+	}
+}
+
+bool OBJGeometryLoader::loadFrom(
+	const std::string& filepath,
+	std::vector<DirectX::XMUINT3>* pIndices,
+	std::vector<DirectX::XMFLOAT3>* pVertices
+) {
+	MappedFile file{};
+	if (!file.open(filepath))
+		return false;
+
+	const char* data{ reinterpret_cast<const char*>(file.data()) };
+	size_t size{ file.size() };
+
+	// chunks start right after newline
+	int chunksCnt{ 4 * Parallel::threadsCnt() };
+	std::vector<size_t> bounds(chunksCnt + 1, size);
+	bounds[0] = 0;
+	for (int c{ 1 }; c < chunksCnt; ++c) {
+		size_t pos{ std::max<size_t>(bounds[c - 1], size * c / chunksCnt) };
+		const char* nl{ pos < size ? static_cast<const char*>(std::memchr(data + pos, '\n', size - pos)) : nullptr };
+		bounds[c] = nl ? nl - data + 1 : size;
+	}
+
+	// first pass counts output so second one writes in place
+	std::vector<int> verticesOffsets(chunksCnt + 1);
+	std::vector<int> indicesOffsets(chunksCnt + 1);
+	Parallel::forEach(0, chunksCnt, [&](int c) {
+		int verticesCnt{}, trisCnt{};
+		forEachLine(data + bounds[c], data + bounds[c + 1], [&](char type, const char* first, const char* last) {
+			if (type == 'v')
+				++verticesCnt;
+			else
+				trisCnt += std::max<int>(0, faceVerticesCnt(first, last) - 2);
+		});
+		verticesOffsets[c + 1] = verticesCnt;
+		indicesOffsets[c + 1] = trisCnt;
+	});
+
+	for (int c{}; c < chunksCnt; ++c) {
+		verticesOffsets[c + 1] += verticesOffsets[c];
+		indicesOffsets[c + 1] += indicesOffsets[c];
+	}
+
+	int verticesCnt{ verticesOffsets[chunksCnt] };
+	pVertices->assign(verticesCnt, XMFLOAT3{});
+	pIndices->assign(indicesOffsets[chunksCnt], XMUINT3{});
+
+	std::atomic<bool> isValid{ verticesCnt > 0 };
+	Parallel::forEach(0, chunksCnt, [&](int c) {
+		int vertexId{ verticesOffsets[c] };
+		int triId{ indicesOffsets[c] };
+
+		forEachLine(data + bounds[c], data + bounds[c + 1], [&](char type, const char* first, const char* last) {
+			const char* p{ skipSpaces(first, last) };
+
+			if (type == 'v') {
+				XMFLOAT3& vertex{ (*pVertices)[vertexId++] };
+
+				float* coords{ &vertex.x };
+				for (int i{}; i < 3; ++i) {
+					auto res{ std::from_chars(p, last, coords[i]) };
+					if (res.ec != std::errc{})
+						isValid = false;
+					p = skipSpaces(res.ptr, last);
+				}
+				return;
+			}
+
+			// "i", "i/t", "i//n" or "i/t/n", negative indices are relative to vertices read so far
+			uint32_t fan[2]{};
+			for (int i{}; p < last; ++i) {
+				int id{};
+				auto res{ std::from_chars(p, last, id) };
+				if (res.ec != std::errc{} || !id) {
+					isValid = false;
+					return;
+				}
+				id = id < 0 ? vertexId + id : id - 1;
+				if (id < 0 || id >= verticesCnt)
+					isValid = false;
+
+				if (i < 2)
+					fan[i] = static_cast<uint32_t>(id);
+				else {
+					(*pIndices)[triId++] = { fan[0], fan[1], static_cast<uint32_t>(id) };
+					fan[1] = static_cast<uint32_t>(id);
+				}
+
+				p = skipSpaces(skipToken(res.ptr, last), last);
+			}
+		});
+	});
+
+	if (!isValid) {
+		pIndices->clear();
+		pVertices->clear();
+		return false;
+	}
+
+	VertexWelder::weld(pIndices, pVertices);
+	return true;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "framework.h"
+
+#include <vector>
+
+struct OBJGeometryLoader {
+	// positions and faces only, polygons are fan triangulated and equal positions welded
+	static bool loadFrom(
+		const std::string& filepath,
+		std::vector<DirectX::XMUINT3>* indices,
+		std::vector<DirectX::XMFLOAT3>* vertices
+	);
+};
@@ -0,0 +1,336 @@
+#include "PLYGeometryLoader.h"
+
+#include <atomic>
+#include <cstring>
+#include <sstream>
+
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "VertexWelder.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+	// 'i' - signed, 'u' - unsigned, 'f' - floating
+	struct Type {
+		char kind{};
+		int size{};
+	};
+
+	struct Property {
+		std::string name{};
+		Type type{};
+		// list count type, zero size for scalar
+		Type countType{};
+	};
+
+	struct Element {
+		std::string name{};
+		size_t cnt{};
+		std::vector<Property> props{};
+
+		bool hasLists() const {
+			return std::any_of(props.begin(), props.end(), [](const Property& prop) {
+				return prop.countType.size;
+			});
+		}
+
+		// only for elements without lists
+		size_t stride() const {
+			size_t size{};
+			for (const Property& prop : props)
+				size += prop.type.size;
+			return size;
+		}
+
+		int find(const std::string& propName) const {
+			for (int i{}; i < static_cast<int>(props.size()); ++i) {
+				if (props[i].name == propName)
+					return i;
+			}
+			return -1;
+		}
+	};
+
+	bool parseType(const std::string& name, Type& type) {
+		static const std::pair<const char*, Type> types[]{
+			{ "char", { 'i', 1 } }, { "int8", { 'i', 1 } },
+			{ "uchar", { 'u', 1 } }, { "uint8", { 'u', 1 } },
+			{ "short", { 'i', 2 } }, { "int16", { 'i', 2 } },
+			{ "ushort", { 'u', 2 } }, { "uint16", { 'u', 2 } },
+			{ "int", { 'i', 4 } }, { "int32", { 'i', 4 } },
+			{ "uint", { 'u', 4 } }, { "uint32", { 'u', 4 } },
+			{ "float", { 'f', 4 } }, { "float32", { 'f', 4 } },
+			{ "double", { 'f', 8 } }, { "float64", { 'f', 8 } }
+		};
+
+		for (const auto& [typeName, t] : types) {
+			if (name == typeName) {
+				type = t;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	template <typename T>
+	T read(const uint8_t* p) {
+		T value{};
+		std::memcpy(&value, p, sizeof(T));
+		return value;
+	}
+
+	double readFloat(const uint8_t* p, Type type) {
+		switch (type.kind) {
+		case 'f': return type.size == 4 ? read<float>(p) : read<double>(p);
+		case 'i': return type.size == 1 ? read<int8_t>(p) : type.size == 2 ? read<int16_t>(p) : read<int32_t>(p);
+		default: return type.size == 1 ? read<uint8_t>(p) : type.size == 2 ? read<uint16_t>(p) : read<uint32_t>(p);
+		}
+	}
+
+	int64_t readInt(const uint8_t* p, Type type) {
+		switch (type.kind) {
+		case 'f': return static_cast<int64_t>(readFloat(p, type));
+		case 'i': return type.size == 1 ? read<int8_t>(p) : type.size == 2 ? read<int16_t>(p) : read<int32_t>(p);
+		default: return type.size == 1 ? read<uint8_t>(p) : type.size == 2 ? read<uint16_t>(p) : read<uint32_t>(p);
+		}
+	}
+
+	// size of one record, zero if it does not fit before end, listCnt is length of list property listProp
+	size_t recordSize(const Element& element, const uint8_t* p, const uint8_t* end, int listProp, int64_t& listCnt) {
+		const uint8_t* first{ p };
+		for (int i{}; i < static_cast<int>(element.props.size()); ++i) {
+			const Property& prop{ element.props[i] };
+			if (prop.countType.size) {
+				if (end - p < prop.countType.size)
+					return 0;
+				int64_t cnt{ readInt(p, prop.countType) };
+				p += prop.countType.size;
+				if (cnt < 0 || (end - p) / prop.type.size < cnt)
+					return 0;
+				p += cnt * prop.type.size;
+				if (i == listProp)
+					listCnt = cnt;
+			}
+			else {
+				if (end - p < prop.type.size)
+					return 0;
+				p += prop.type.size;
+			}
+		}
+		return p - first;
+	}
+
+	bool parseHeader(const char* text, size_t size, std::vector<Element>& elements, size_t& bodyOffset) {
+		static const char endHeader[]{ "end_header" };
+
+		const char* end{ text + size };
+		const char* p{ text };
+		for (; p < end; ++p) {
+			p = static_cast<const char*>(std::memchr(p, 'e', end - p));
+			if (!p)
+				return false;
+			if (end - p >= sizeof(endHeader) - 1 && !std::memcmp(p, endHeader, sizeof(endHeader) - 1))
+				break;
+		}
+
+		const char* nl{ static_cast<const char*>(std::memchr(p, '\n', end - p)) };
+		if (!nl)
+			return false;
+		bodyOffset = nl - text + 1;
+
+		std::istringstream header{ std::string(text, p) };
+		std::string line{};
+		bool isBinaryLE{};
+		while (std::getline(header, line)) {
+			std::istringstream words{ line };
+			std::string keyword{};
+			words >> keyword;
+
+			if (keyword == "format") {
+				std::string format{};
+				words >> format;
+				isBinaryLE = format == "binary_little_endian";
+			}
+			else if (keyword == "element") {
+				Element element{};
+				words >> element.name >> element.cnt;
+				elements.push_back(element);
+			}
+			else if (keyword == "property") {
+				if (elements.empty())
+					return false;
+
+				std::string typeName{};
+				Property prop{};
+				words >> typeName;
+				if (typeName == "list") {
+					std::string countTypeName{};
+					words >> countTypeName >> typeName;
+					if (!parseType(countTypeName, prop.countType) || prop.countType.kind == 'f')
+						return false;
+				}
+				if (!parseType(typeName, prop.type))
+					return false;
+				words >> prop.name;
+
+				elements.back().props.push_back(prop);
+			}
+		}
+
+		return isBinaryLE;
+	}
+}
+
+bool PLYGeometryLoader::loadFrom(
+	const std::string& filepath,
+	std::vector<DirectX::XMUINT3>* pIndices,
+	std::vector<DirectX::XMFLOAT3>* pVertices
+) {
+	MappedFile file{};
+	if (!file.open(filepath) || file.size() < 4 || std::memcmp(file.data(), "ply", 3))
+		return false;
+
+	std::vector<Element> elements{};
+	size_t offset{};
+	if (!parseHeader(reinterpret_cast<const char*>(file.data()), file.size(), elements, offset))
+		return false;
+
+	const uint8_t* end{ file.data() + file.size() };
+
+	auto found = std::find_if(elements.begin(), elements.end(), [](const Element& element) {
+		return element.name == "face";
+	});
+	if (found == elements.end())
+		return false;
+
+	const Element& faceElement{ *found };
+	int indicesProp{ faceElement.find("vertex_indices") };
+	if (indicesProp < 0)
+		indicesProp = faceElement.find("vertex_index");
+	if (indicesProp < 0 || !faceElement.props[indicesProp].countType.size)
+		return false;
+
+	// face records have variable size, so chunk starts are found while walking over them
+	int chunksCnt{ 4 * Parallel::threadsCnt() };
+	size_t facesPerChunk{ std::max<size_t>(1, (faceElement.cnt + chunksCnt - 1) / chunksCnt) };
+	std::vector<const uint8_t*> chunkBounds{};
+	std::vector<int> indicesOffsets{};
+	int trisCnt{};
+
+	// element records are stored one after another in header order
+	const Element* pVertexElement{};
+	const uint8_t* pVertexData{};
+	for (const Element& element : elements) {
+		const uint8_t* first{ file.data() + offset };
+		bool isFace{ &element == &faceElement };
+
+		size_t size{};
+		if (!element.hasLists()) {
+			size = element.stride() * element.cnt;
+			if (static_cast<size_t>(end - first) < size)
+				return false;
+		}
+		else {
+			for (size_t i{}; i < element.cnt; ++i) {
+				if (isFace && i % facesPerChunk == 0) {
+					chunkBounds.push_back(first + size);
+					indicesOffsets.push_back(trisCnt);
+				}
+
+				int64_t cnt{};
+				size_t record{ recordSize(element, first + size, end, isFace ? indicesProp : -1, cnt) };
+				if (!record)
+					return false;
+				size += record;
+
+				trisCnt += static_cast<int>(std::max<int64_t>(0, cnt - 2));
+			}
+		}
+
+		if (isFace)
+			chunkBounds.push_back(first + size);
+		if (element.name == "vertex") {
+			pVertexElement = &element;
+			pVertexData = first;
+		}
+
+		offset += size;
+	}
+
+	if (!pVertexElement || pVertexElement->hasLists())
+		return false;
+
+	// vertex records have fixed stride
+	const Element& vertexElement{ *pVertexElement };
+	int coordProps[3]{ vertexElement.find("x"), vertexElement.find("y"), vertexElement.find("z") };
+	if (coordProps[0] < 0 || coordProps[1] < 0 || coordProps[2] < 0)
+		return false;
+
+	size_t coordOffsets[3]{};
+	for (int i{}; i < 3; ++i) {
+		for (int p{}; p < coordProps[i]; ++p)
+			coordOffsets[i] += vertexElement.props[p].type.size;
+	}
+
+	int verticesCnt{ static_cast<int>(vertexElement.cnt) };
+	size_t stride{ vertexElement.stride() };
+	pVertices->assign(verticesCnt, XMFLOAT3{});
+	Parallel::forEach(0, verticesCnt, [&](int i) {
+		const uint8_t* record{ pVertexData + i * stride };
+		(*pVertices)[i] = {
+			static_cast<float>(readFloat(record + coordOffsets[0], vertexElement.props[coordProps[0]].type)),
+			static_cast<float>(readFloat(record + coordOffsets[1], vertexElement.props[coordProps[1]].type)),
+			static_cast<float>(readFloat(record + coordOffsets[2], vertexElement.props[coordProps[2]].type))
+		};
+	}, 4096);
+
+	pIndices->assign(trisCnt, XMUINT3{});
+
+	std::atomic<bool> isValid{ true };
+	Parallel::forEach(0, static_cast<int>(chunkBounds.size()) - 1, [&](int c) {
+		const uint8_t* record{ chunkBounds[c] };
+		const uint8_t* chunkEnd{ chunkBounds[c + 1] };
+		int triId{ indicesOffsets[c] };
+
+		while (record < chunkEnd) {
+			for (int p{}; p < static_cast<int>(faceElement.props.size()); ++p) {
+				const Property& prop{ faceElement.props[p] };
+				if (!prop.countType.size) {
+					record += prop.type.size;
+					continue;
+				}
+
+				int64_t cnt{ readInt(record, prop.countType) };
+				record += prop.countType.size;
+
+				if (p == indicesProp) {
+					uint32_t fan[2]{};
+					for (int64_t i{}; i < cnt; ++i) {
+						int64_t id{ readInt(record + i * prop.type.size, prop.type) };
+						if (id < 0 || id >= verticesCnt)
+							isValid = false;
+
+						if (i < 2)
+							fan[i] = static_cast<uint32_t>(id);
+						else {
+							(*pIndices)[triId++] = { fan[0], fan[1], static_cast<uint32_t>(id) };
+							fan[1] = static_cast<uint32_t>(id);
+						}
+					}
+				}
+				record += cnt * prop.type.size;
+			}
+		}
+	});
+
+	if (!isValid) {
+		pIndices->clear();
+		pVertices->clear();
+		return false;
+	}
+
+	VertexWelder::weld(pIndices, pVertices);
+	return true;
+}
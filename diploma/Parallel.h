@@ -0,0 +1,42 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace Parallel {
+	inline int& threadsCnt() {
+		static int cnt{ std::max<int>(1, static_cast<int>(std::thread::hardware_concurrency())) };
+		return cnt;
+	}
+
+	// calls f(i) for every i in [begin, end), threads grab chunks of grain indices
+	template <typename F>
+	void forEach(int begin, int end, F f, int grain = 1) {
+		int cnt{ end - begin };
+		int threads{ std::min<int>(threadsCnt(), (cnt + grain - 1) / std::max<int>(1, grain)) };
+
+		if (threads <= 1) {
+			for (int i{ begin }; i < end; ++i)
+				f(i);
+			return;
+		}
+
+		std::atomic<int> next{ begin };
+		auto worker = [&]() {
+			for (int first{ next.fetch_add(grain) }; first < end; first = next.fetch_add(grain)) {
+				for (int i{ first }; i < std::min<int>(end, first + grain); ++i)
+					f(i);
+			}
+		};
+
+		std::vector<std::thread> pool{};
+		for (int t{ 1 }; t < threads; ++t)
+			pool.emplace_back(worker);
+		worker();
+
+		for (std::thread& t : pool)
+			t.join();
+	}
+}
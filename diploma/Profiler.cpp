@@ -0,0 +1,131 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define PROFILER_RDTSC
+#endif
+
+namespace {
+	struct Buffer {
+		std::vector<Profiler::Event> events{ std::vector<Profiler::Event>(Profiler::Capacity) };
+		uint64_t cnt{};
+		int tid{};
+	};
+
+	// buffers outlive threads, Parallel spawns new ones on every call and they reuse free buffers
+	struct Registry {
+		std::mutex mutex{};
+		std::vector<std::unique_ptr<Buffer>> buffers{};
+		std::vector<Buffer*> free{};
+
+		// pair of timestamps to convert ticks to microseconds
+		uint64_t ticksStart{ Profiler::now() };
+		std::chrono::steady_clock::time_point timeStart{ std::chrono::steady_clock::now() };
+	};
+
+	Registry& registry() {
+		static Registry registry{};
+		return registry;
+	}
+
+	struct Holder {
+		Buffer* pBuffer{};
+
+		~Holder() {
+			if (!pBuffer)
+				return;
+
+			std::lock_guard<std::mutex> lock{ registry().mutex };
+			registry().free.push_back(pBuffer);
+		}
+	};
+
+	Buffer& threadBuffer() {
+		thread_local Holder holder{};
+		if (holder.pBuffer)
+			return *holder.pBuffer;
+
+		Registry& reg{ registry() };
+		std::lock_guard<std::mutex> lock{ reg.mutex };
+		if (!reg.free.empty()) {
+			holder.pBuffer = reg.free.back();
+			reg.free.pop_back();
+		}
+		else {
+			reg.buffers.push_back(std::make_unique<Buffer>());
+			reg.buffers.back()->tid = static_cast<int>(reg.buffers.size()) - 1;
+			holder.pBuffer = reg.buffers.back().get();
+		}
+		return *holder.pBuffer;
+	}
+}
+
+uint64_t Profiler::now() {
+#ifdef PROFILER_RDTSC
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void Profiler::record(const Event& event) {
+	Buffer& buffer{ threadBuffer() };
+	buffer.events[buffer.cnt++ % Capacity] = event;
+}
+
+void Profiler::clear() {
+	Registry& reg{ registry() };
+	std::lock_guard<std::mutex> lock{ reg.mutex };
+	for (auto& buffer : reg.buffers)
+		buffer->cnt = 0;
+
+	reg.ticksStart = now();
+	reg.timeStart = std::chrono::steady_clock::now();
+}
+
+bool Profiler::saveChromeTrace(const std::string& path) {
+	Registry& reg{ registry() };
+	std::lock_guard<std::mutex> lock{ reg.mutex };
+
+	double us{ std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - reg.timeStart).count() };
+	double usPerTick{ us / std::max<double>(1., static_cast<double>(now() - reg.ticksStart)) };
+
+	std::ofstream file{ path };
+	if (!file)
+		return false;
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+	bool isFirst{ true };
+	for (const auto& buffer : reg.buffers) {
+		uint64_t first{ buffer->cnt > Capacity ? buffer->cnt - Capacity : 0 };
+		for (uint64_t i{ first }; i < buffer->cnt; ++i) {
+			const Event& event{ buffer->events[i % Capacity] };
+
+			// zone open during clear may start before it
+			double ts{ (static_cast<int64_t>(event.start - reg.ticksStart)) * usPerTick };
+			double dur{ (event.end - event.start) * usPerTick };
+
+			file << (isFirst ? "" : ",\n") << "  {\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << buffer->tid
+				<< ", \"ts\": " << std::max<double>(0., ts) << ", \"dur\": " << dur << "}";
+			isFirst = false;
+		}
+	}
+
+	file << "\n]}\n";
+
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// scoped zones compiled in only if PROFILER_ZONES is defined,
+// each thread writes own ring buffer, saved as chrome trace events
+#ifdef PROFILER_ZONES
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name) Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__){ name }
+// sequential phases of one scope: PROFILE_PHASE(phase, "a"); ... PROFILE_NEXT(phase, "b");
+#define PROFILE_PHASE(var, name) Profiler::Zone var{ name }
+#define PROFILE_NEXT(var, name) var.next(name)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_PHASE(var, name)
+#define PROFILE_NEXT(var, name)
+#endif
+
+class Profiler {
+public:
+#ifdef PROFILER_ZONES
+	static constexpr bool IsOn{ true };
+#else
+	static constexpr bool IsOn{ false };
+#endif
+
+	// events kept per thread, older ones are overwritten
+	static constexpr size_t Capacity{ 1 << 16 };
+
+	struct Event {
+		const char* name{};
+		uint64_t start{};
+		uint64_t end{};
+	};
+
+	class Zone {
+		const char* m_name{};
+		uint64_t m_start{};
+
+	public:
+		Zone() = delete;
+		Zone(const char* name) :
+			m_name(name), m_start(now()) {}
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+		~Zone() {
+			record({ m_name, m_start, now() });
+		}
+
+		void next(const char* name) {
+			uint64_t time{ now() };
+			record({ m_name, m_start, time });
+			m_name = name;
+			m_start = time;
+		}
+	};
+
+	// rdtsc on x64, steady clock nanoseconds elsewhere
+	static uint64_t now();
+
+	static void record(const Event& event);
+
+	// drops recorded events of all threads, call when no zone is open
+	static void clear();
+
+	// chrome://tracing and perfetto json, call when no zone is open
+	static bool saveChromeTrace(const std::string& path);
+};
@@ -0,0 +1,115 @@
+#include "RayStatsExport.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+
+int RayStatsExport::value(const CPUTracer::RayStats& stats, int counter) {
+	switch (counter) {
+	case 0:
+		return stats.nodes;
+	case 1:
+		return stats.boxes;
+	case 2:
+		return stats.tris;
+	case 3:
+		return stats.depth;
+	default:
+		return stats.iters;
+	}
+}
+
+int RayStatsExport::maxValue(const std::vector<CPUTracer::RayStats>& stats, int counter) {
+	int res{};
+	for (const CPUTracer::RayStats& ray : stats)
+		res = std::max<int>(res, value(ray, counter));
+	return res;
+}
+
+bool RayStatsExport::saveHeatmap(const std::string& path, const std::vector<CPUTracer::RayStats>& stats, int width, int height, int counter) {
+	if (width <= 0 || height <= 0 || stats.size() < static_cast<size_t>(width) * height)
+		return false;
+
+	float scale{ 1.f / std::max<int>(1, maxValue(stats, counter)) };
+
+	// 4 segments of ramp: black - blue - green - yellow - red
+	const DirectX::SimpleMath::Vector3 ramp[5]{ { 0.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, { 0.f, 1.f, 0.f }, { 1.f, 1.f, 0.f }, { 1.f, 0.f, 0.f } };
+
+	return saveBMP(path, width, height, [&](int x, int y) {
+		float v{ 4.f * value(stats[static_cast<size_t>(y) * width + x], counter) * scale };
+		int i{ std::min<int>(3, static_cast<int>(v)) };
+		return DirectX::SimpleMath::Vector3::Lerp(ramp[i], ramp[i + 1], v - i);
+	});
+}
+
+bool RayStatsExport::saveHistogram(const std::string& path, const std::vector<CPUTracer::RayStats>& stats, int counter) {
+	int valuesCnt{ maxValue(stats, counter) + 1 };
+	int binWidth{ (valuesCnt + BinsCnt - 1) / BinsCnt };
+	int binsCnt{ (valuesCnt + binWidth - 1) / binWidth };
+
+	std::vector<long long> bins(binsCnt);
+	for (const CPUTracer::RayStats& ray : stats)
+		++bins[value(ray, counter) / binWidth];
+
+	std::ofstream file{ path };
+	if (!file)
+		return false;
+
+	file << "from,to,rays\n";
+	for (int i{}; i < binsCnt; ++i)
+		file << i * binWidth << ',' << (i + 1) * binWidth - 1 << ',' << bins[i] << '\n';
+
+	return static_cast<bool>(file);
+}
+
+bool RayStatsExport::saveBMP(const std::string& path, int width, int height, const std::function<DirectX::SimpleMath::Vector3(int x, int y)>& color) {
+	if (width <= 0 || height <= 0)
+		return false;
+
+	// rows are padded to 4 bytes and stored bottom up
+	uint32_t rowSize{ (3u * width + 3u) & ~3u };
+	uint32_t dataSize{ rowSize * height };
+
+#pragma pack(push, 1)
+	struct {
+		uint16_t type{ 0x4D42 };
+		uint32_t fileSize{};
+		uint32_t reserved{};
+		uint32_t dataOffset{ 54 };
+		uint32_t headerSize{ 40 };
+		int32_t width{};
+		int32_t height{};
+		uint16_t planes{ 1 };
+		uint16_t bitsPerPixel{ 24 };
+		uint32_t compression{};
+		uint32_t dataSize{};
+		int32_t ppmX{ 2835 };
+		int32_t ppmY{ 2835 };
+		uint32_t colorsUsed{};
+		uint32_t colorsImportant{};
+	} header{};
+#pragma pack(pop)
+	header.fileSize = 54 + dataSize;
+	header.width = width;
+	header.height = height;
+	header.dataSize = dataSize;
+
+	std::ofstream file{ path, std::ios::binary };
+	if (!file)
+		return false;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	std::vector<uint8_t> row(rowSize);
+	for (int y{ height - 1 }; y >= 0; --y) {
+		for (int x{}; x < width; ++x) {
+			DirectX::SimpleMath::Vector3 c{ color(x, y) };
+			// bgr order
+			row[3 * x + 0] = static_cast<uint8_t>(255.f * std::clamp<float>(c.z, 0.f, 1.f) + .5f);
+			row[3 * x + 1] = static_cast<uint8_t>(255.f * std::clamp<float>(c.y, 0.f, 1.f) + .5f);
+			row[3 * x + 2] = static_cast<uint8_t>(255.f * std::clamp<float>(c.x, 0.f, 1.f) + .5f);
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), rowSize);
+	}
+
+	return static_cast<bool>(file);
+}
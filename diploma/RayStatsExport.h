@@ -0,0 +1,30 @@
+#pragma once
+
+#include "framework.h"
+
+#include <functional>
+
+#include "CPUTracer.h"
+
+// images and histograms of per ray counters left by CPUTracer::traceFrame
+class RayStatsExport {
+public:
+	static constexpr int CountersCnt{ 5 };
+	static constexpr const char* CounterNames[CountersCnt]{ "nodes", "boxes", "tris", "depth", "iters" };
+
+	static int value(const CPUTracer::RayStats& stats, int counter);
+
+	// 24 bit bmp, black - blue - green - yellow - red from 0 to max value
+	static bool saveHeatmap(const std::string& path, const std::vector<CPUTracer::RayStats>& stats, int width, int height, int counter);
+
+	// csv of rays count per value range, at most BinsCnt bins
+	static bool saveHistogram(const std::string& path, const std::vector<CPUTracer::RayStats>& stats, int counter);
+
+	// 24 bit bmp of rgb in [0, 1] per pixel, values outside are clamped
+	static bool saveBMP(const std::string& path, int width, int height, const std::function<DirectX::SimpleMath::Vector3(int x, int y)>& color);
+
+private:
+	static constexpr int BinsCnt{ 64 };
+
+	static int maxValue(const std::vector<CPUTracer::RayStats>& stats, int counter);
+};
@@ -3,6 +3,9 @@
 
 #define MAX_LEVEL 15
 #define MAX_STACK 4
+// shadow ray stack holds up to depth * (children - 1) + 1 nodes: binary depth 127 or wide depth 42,
+// deeper trees overflow it and such rays are reported occluded instead of dropping subtrees
+#define MAX_OCCLUSION_STACK 128
 
 cbuffer ModelBuffer: register(b0) {
     int4 primsCnt;
@@ -17,13 +20,20 @@ cbuffer RTBuffer: register(b1) {
     int4 instsAlgLeafsTCheck;
     float4 camDir;
     int4 highlights;
+    float4 lightPos;
+    int4 shadows;
 }
 
-StructuredBuffer<float4> vertices : register(t0);
+StructuredBuffer<float3> vertices : register(t0);
 
-StructuredBuffer<int4> indices : register(t1);
+// r16_uint or r32_uint view, 3 indices per triangle
+Buffer<uint> indices : register(t1);
 
-StructuredBuffer<uint4> triIdx : register(t2);
+float4 triVertex(int tId, int k) {
+    return float4(vertices[indices[3 * tId + k]], 1.f);
+}
+
+StructuredBuffer<uint> primIds : register(t2);
 
 struct AABB {
     float4 bmin, bmax;
@@ -36,6 +46,25 @@ struct BVHNode {
 
 StructuredBuffer<BVHNode> nodes: register(t3);
 
+// world space triangles in leafs order, primsCnt.y != 0 if used
+struct FlatTri {
+    float3 v0;
+    int primId;
+    float3 e1;
+    int pad0;
+    float3 e2;
+    int pad1;
+};
+
+StructuredBuffer<FlatTri> flatTris: register(t4);
+
+// 2 bits per prim: aabb, split, primsCnt.z != 0 if used
+StructuredBuffer<uint> primHighlights: register(t5);
+
+uint primHighlight(int primId) {
+    return (primHighlights[primId >> 4] >> ((primId & 15) * 2)) & 3;
+}
+
 struct Ray {
     float4 orig;
     float4 dest;
@@ -73,15 +102,11 @@ Ray generateRay(float2 screenPoint) {
 }
 
 // Moller-Trumbore Intersection Algorithm
-Intsec rayTriangleIntersection(Ray ray, float4 v0, float4 v1, float4 v2) {
+Intsec rayTriangleIntersection(Ray ray, float3 v0, float3 e1, float3 e2) {
     Intsec intsec;
     intsec.mId = intsec.tId = -1;
     intsec.t = intsec.u = intsec.v = -1.f;
 
-    // edges
-    float3 e1 = v1.xyz - v0.xyz;
-    float3 e2 = v2.xyz - v0.xyz;
-
     float3 h = cross(ray.dir.xyz, e2);
     float a = dot(e1, h);
 
@@ -89,7 +114,7 @@ Intsec rayTriangleIntersection(Ray ray, float4 v0, float4 v1, float4 v2) {
     if (abs(a) < 1e-8)
         return intsec;
 
-    float3 s = ray.orig.xyz - v0.xyz;
+    float3 s = ray.orig.xyz - v0;
     intsec.u = dot(s, h) / a;
 
     // check u range
@@ -107,6 +132,10 @@ Intsec rayTriangleIntersection(Ray ray, float4 v0, float4 v1, float4 v2) {
     return intsec;
 }
 
+Intsec rayTriangleIntersection(Ray ray, float4 v0, float4 v1, float4 v2) {
+    return rayTriangleIntersection(ray, v0.xyz, v1.xyz - v0.xyz, v2.xyz - v0.xyz);
+}
+
 // naive intersection part
 Intsec naiveIntersection(Ray ray) {
     Intsec best;
@@ -122,9 +151,9 @@ Intsec naiveIntersection(Ray ray) {
 
         for (int i = 0; i < primsCnt.x; ++i)
         {
-            float4 v0 = vertices[indices[i].x];
-            float4 v1 = vertices[indices[i].y];
-            float4 v2 = vertices[indices[i].z];
+            float4 v0 = triVertex(i, 0);
+            float4 v1 = triVertex(i, 1);
+            float4 v2 = triVertex(i, 2);
 
             Intsec curr = rayTriangleIntersection(mRay, v0, v1, v2);
 
@@ -159,19 +188,34 @@ Intsec bestBVHLeafIntersection(Ray ray, int nodeId) {
     best.t = whnf.w;
     best.u = best.v = -1.f;
 
+    if (primsCnt.y) {
+        for (int i = 0; i < nodes[nodeId].leftCntPar.y; ++i) {
+            FlatTri tri = flatTris[nodes[nodeId].leftCntPar.x + i];
+
+            Intsec curr = rayTriangleIntersection(ray, tri.v0, tri.e1, tri.e2);
+
+            if (whnf.z < curr.t && curr.t < best.t) {
+                best = curr;
+                best.mId = 0;
+                best.tId = tri.primId;
+            }
+        }
+
+        return best;
+    }
     
     for (int i = 0; i < nodes[nodeId].leftCntPar.y; ++i) {
-        int mId = triIdx[nodes[nodeId].leftCntPar.x + i].x / primsCnt.x;
-        int tId = triIdx[nodes[nodeId].leftCntPar.x + i].x % primsCnt.x;
+        int mId = primIds[nodes[nodeId].leftCntPar.x + i] / primsCnt.x;
+        int tId = primIds[nodes[nodeId].leftCntPar.x + i] % primsCnt.x;
 
         Ray mRay;
         mRay.orig = mul(mModelInv, ray.orig);
         mRay.dest = mul(mModelInv, ray.dest);
         mRay.dir = normalize(mRay.dest - mRay.orig);
 
-        float4 v0 = vertices[indices[tId].x];
-        float4 v1 = vertices[indices[tId].y];
-        float4 v2 = vertices[indices[tId].z];
+        float4 v0 = triVertex(tId, 0);
+        float4 v1 = triVertex(tId, 1);
+        float4 v2 = triVertex(tId, 2);
 
         Intsec curr = rayTriangleIntersection(mRay, v0, v1, v2);
         curr.t = mul(mModel, curr.t);
@@ -603,6 +647,75 @@ Intsec bvhStacklessIntersectionQBVH(Ray ray)
 //    return best;
 //}
 
+// occlusion part
+bool rayHitsAABB(Ray ray, AABB aabb, float tmin, float tmax) {
+    float4 v1 = (aabb.bmin - ray.orig) / ray.dir;
+    float4 v2 = (aabb.bmax - ray.orig) / ray.dir;
+
+    float3 vmin = min(v1.xyz, v2.xyz);
+    float3 vmax = max(v1.xyz, v2.xyz);
+
+    float tEntry = max(max(vmin.x, vmin.y), vmin.z);
+    float tExit = min(min(vmax.x, vmax.y), vmax.z);
+
+    return tmin < tExit && tEntry <= tExit && tEntry < tmax;
+}
+
+bool primOccludes(Ray ray, int primRefId, float tmin, float tmax) {
+    Intsec curr;
+
+    if (primsCnt.y) {
+        FlatTri tri = flatTris[primRefId];
+        curr = rayTriangleIntersection(ray, tri.v0, tri.e1, tri.e2);
+    }
+    else {
+        int tId = primIds[primRefId] % primsCnt.x;
+
+        Ray mRay;
+        mRay.orig = mul(mModelInv, ray.orig);
+        mRay.dest = mul(mModelInv, ray.dest);
+        mRay.dir = normalize(mRay.dest - mRay.orig);
+
+        curr = rayTriangleIntersection(mRay, triVertex(tId, 0), triVertex(tId, 1), triVertex(tId, 2));
+        curr.t = mul(mModel, curr.t);
+    }
+
+    return tmin < curr.t && curr.t < tmax;
+}
+
+// any hit in (tmin, tmax), no nearest child ordering
+bool bvhOcclusion(Ray ray, float tmin, float tmax) {
+    bool isWide = nodes[0].leftCntPar.z != -1;
+
+    int stack[MAX_OCCLUSION_STACK];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        BVHNode node = nodes[stack[--stackSize]];
+
+        if (!rayHitsAABB(ray, node.bb, tmin, tmax))
+            continue;
+
+        if (node.leftCntPar.y == 0) {
+            int childsCnt = isWide ? node.leftCntPar.w : 2;
+            if (stackSize + childsCnt > MAX_OCCLUSION_STACK)
+                return true;
+
+            for (int i = 0; i < childsCnt; ++i)
+                stack[stackSize++] = node.leftCntPar.x + i;
+            continue;
+        }
+
+        for (int i = 0; i < node.leftCntPar.y; ++i) {
+            if (primOccludes(ray, node.leftCntPar.x + i, tmin, tmax))
+                return true;
+        }
+    }
+
+    return false;
+}
+
 [numthreads(1, 1, 1)]
 void main(uint3 DTid: SV_DispatchThreadID) {
     Ray ray = generateRay(DTid.xy);
@@ -636,13 +749,29 @@ void main(uint3 DTid: SV_DispatchThreadID) {
     float4 colorFar = float4(0.75f, 0.75f, 0.75f, 1.f);
         
     float4 color = lerp(colorNear, colorFar, 1.f - 1.f / depth);
-    
-    if (triIdx[best.tId].z == 1) {
-        color.x += (1.f - color.x) / 0.5f;
+
+    // point light shadow
+    if (shadows.x == 1) {
+        Ray shadowRay;
+        shadowRay.orig = ray.orig + best.t * ray.dir;
+        shadowRay.dest = float4(lightPos.xyz, 1.f);
+        shadowRay.dir = float4(normalize(shadowRay.dest.xyz - shadowRay.orig.xyz), 0.f);
+
+        float dist = length(shadowRay.dest.xyz - shadowRay.orig.xyz);
+        if (bvhOcclusion(shadowRay, 1e-4f * dist, dist))
+            color.xyz *= 0.5f;
     }
     
-    if (triIdx[best.tId].w == 1) {
-        color.z += (1.f - color.z) / 0.5f;
+    if (primsCnt.z) {
+        uint highlight = primHighlight(best.tId);
+
+        if (highlight & 1) {
+            color.x += (1.f - color.x) / 0.5f;
+        }
+
+        if (highlight & 2) {
+            color.z += (1.f - color.z) / 0.5f;
+        }
     }
     
     //if (best.tId == highlights.x) {
@@ -2,6 +2,9 @@
 
 #include <cmath>
 
+#include "Profiler.h"
+#include "RayStatsExport.h"
+
 using namespace DirectX;
 using namespace DirectX::SimpleMath;
 
@@ -9,6 +12,34 @@ void Renderer::switchRotation() {
 	m_isModelRotate = !m_isModelRotate;
 }
 
+void Renderer::switchCameraRecording() {
+	m_isCameraRecording = !m_isCameraRecording;
+	if (m_isCameraRecording) {
+		m_cameraPlayFrame = -1;
+		m_cameraPath.clear({
+			.width{ static_cast<float>(m_width) },
+			.height{ static_cast<float>(m_height) },
+			.fov{ m_fov },
+			.nearZ{ m_near },
+			.farZ{ m_far }
+		});
+		return;
+	}
+
+	m_cameraPath.save(m_cameraPathFile);
+}
+
+void Renderer::switchCameraPlayback() {
+	if (m_cameraPlayFrame >= 0) {
+		m_cameraPlayFrame = -1;
+		return;
+	}
+
+	m_isCameraRecording = false;
+	if (m_cameraPath.size() || m_cameraPath.load(m_cameraPathFile))
+		m_cameraPlayFrame = 0;
+}
+
 bool Renderer::init(HWND hWnd) {
 	assert(hWnd);
 	HRESULT hr{ S_OK };
@@ -240,6 +271,16 @@ void Renderer::update() {
 	// move camera
 	m_pCamera->updatePosition((time - m_prevTime) / 1e3f);
 
+	// playback overrides input, recording stores what is shown
+	if (m_cameraPlayFrame >= 0) {
+		m_pCamera->setState(m_cameraPath.frame(m_cameraPlayFrame));
+		if (++m_cameraPlayFrame == m_cameraPath.size())
+			m_cameraPlayFrame = -1;
+	}
+	else if (m_isCameraRecording) {
+		m_cameraPath.record(m_pCamera->getState());
+	}
+
 	// update models
 	m_pGeom->update((time - m_prevTime) / 1e3f, m_isModelRotate);
 
@@ -248,19 +289,14 @@ void Renderer::update() {
 	Vector3 cameraPos{ m_pCamera->getPosition() };
 
 	// Setup camera
-	Matrix v{ XMMatrixLookAtLH(cameraPos, m_pCamera->getPoi(), m_pCamera->getUp()) };
+	Matrix v{ m_pCamera->getViewMatrix() };
 	/*Matrix p{ XMMatrixPerspectiveLH(
 		2 * m_far * tanf(m_fov / 2),
 		2 * m_far * tanf(m_fov / 2) * m_height / m_width,
 		m_far,
 		m_near
 	) };*/
-	Matrix p{ XMMatrixPerspectiveLH(
-		2 * m_near * tanf(m_fov / 2),
-		2 * m_near * tanf(m_fov / 2) * m_height / m_width,
-		m_near,
-		m_far
-	) };
+	Matrix p{ Camera::getProjMatrix(m_fov, static_cast<float>(m_width), static_cast<float>(m_height), m_near, m_far) };
 
 	D3D11_MAPPED_SUBRESOURCE subres;
 
@@ -389,6 +425,9 @@ bool Renderer::render() {
 		ImGui::Text("");
 		ImGui::Text("Last time:");
 		ImGui::Text("Last BVH construction time (ms): %.3f", m_pGeom->m_pCPUTimer->getTime());
+		if (Profiler::IsOn && ImGui::Button("Save build profile")) {
+			Profiler::saveChromeTrace("profile.json");
+		}
 		ImGui::Text("Last BVH traverse time (ms): %.3f", m_geomGPUFrameAvgTime);
 		ImGui::Text("Last BVH traverse speed (MRay/s): %.3f", m_geomGPUFrameAvgSpeed / 1e3);
 
@@ -397,6 +436,15 @@ bool Renderer::render() {
 		ImGui::Text("Avg BVH traverse time (ms): %.3f", m_geomGPUAccTime / m_metricCnt);
 		ImGui::Text("Avg BVH traverse speed (MRay/s): %.3f", m_geomGPUAccSpeed / 1e3 / m_metricCnt);
 
+		ImGui::Text("");
+		ImGui::Text("Camera path (R - record, P - play): %d frames", m_cameraPath.size());
+		if (m_isCameraRecording) {
+			ImGui::Text("Recording to %s", m_cameraPathFile.c_str());
+		}
+		else if (m_cameraPlayFrame >= 0) {
+			ImGui::Text("Playing frame %d", m_cameraPlayFrame);
+		}
+
 		ImGui::End();
 	}
 
@@ -436,6 +484,127 @@ bool Renderer::render() {
 			m_rtBuffer.instsAlgLeafsTCheck.w = isTCheck ? 1 : 0;
 		}
 
+		ImGui::Text(" ");
+
+		bool isShadows{ m_rtBuffer.shadows.x == 1 };
+		ImGui::Checkbox("Shadows", &isShadows);
+		m_rtBuffer.shadows.x = isShadows ? 1 : 0;
+		if (isShadows) {
+			ImGui::DragFloat3("Light position", &m_rtBuffer.lightPos.x, 0.1f);
+		}
+
+		ImGui::End();
+	}
+
+	{
+		ImGui::Begin("CPU Ray Tracing");
+
+		ImGui::Checkbox("Simulate L1 cache", &m_pGeom->m_pCPUTracer->m_simulateCache);
+		ImGui::Checkbox("Stackless traversal", &m_pGeom->m_pCPUTracer->m_isStackless);
+
+		if (ImGui::Button("Trace frame")) {
+			m_cpuStats = m_pGeom->cpuTracing(m_rtBuffer.pvInv, m_rtBuffer.whnf);
+		}
+
+		if (ImGui::Button("Trace frame by packets")) {
+			m_cpuStats = m_pGeom->m_pCPUTracer->traceFramePackets(m_rtBuffer.pvInv, m_rtBuffer.whnf);
+		}
+		ImGui::DragInt("Packet min active rays", &m_pGeom->m_pCPUTracer->m_packetMinActive, 1, 0, 64);
+
+		if (ImGui::Button("Trace frame by stream")) {
+			m_cpuStats = m_pGeom->m_pCPUTracer->traceFrameStream(m_rtBuffer.pvInv, m_rtBuffer.whnf);
+		}
+
+		if (ImGui::Button("Relayout by visits")) {
+			m_pGeom->relayoutByVisits(m_rtBuffer.pvInv, m_rtBuffer.whnf);
+			m_cpuStats = m_pGeom->cpuTracing(m_rtBuffer.pvInv, m_rtBuffer.whnf);
+		}
+
+		double rays{ static_cast<double>(std::max<long long>(1, m_cpuStats.rays)) };
+
+		ImGui::Text(" ");
+		ImGui::Text("Trace time (ms): %.3f", m_cpuStats.timeMs);
+		ImGui::Text("Trace speed (MRay/s): %.3f", m_cpuStats.mraysPerSec);
+		ImGui::Text("Hits: %lld / %lld", m_cpuStats.hits, m_cpuStats.rays);
+		ImGui::Text("Nodes per ray: %.3f", m_cpuStats.nodesVisited / rays);
+		ImGui::Text("Prims per ray: %.3f", m_cpuStats.primsTested / rays);
+		ImGui::Text("Cache misses per ray: %.3f", m_cpuStats.cacheMisses / rays);
+
+		if (CPUTracer::IsRayStatsOn && !m_pGeom->m_pCPUTracer->m_rayStats.empty()) {
+			if (ImGui::Button("Save ray stats heatmaps")) {
+				const std::vector<CPUTracer::RayStats>& stats{ m_pGeom->m_pCPUTracer->m_rayStats };
+				for (int i{}; i < RayStatsExport::CountersCnt; ++i) {
+					std::string name{ std::string{ "raystats_" } + RayStatsExport::CounterNames[i] };
+					RayStatsExport::saveHeatmap(name + ".bmp", stats, static_cast<int>(m_rtBuffer.whnf.x), static_cast<int>(m_rtBuffer.whnf.y), i);
+					RayStatsExport::saveHistogram(name + ".csv", stats, i);
+				}
+			}
+		}
+
+		ImGui::Text(" ");
+		if (ImGui::Button("Compare layouts")) {
+			m_layoutsStats = m_pGeom->compareLayouts(m_rtBuffer.pvInv, m_rtBuffer.whnf);
+		}
+
+		const char* layouts[]{ "As built", "DFS", "Treelets", "Treelets by visits" };
+		for (int i{}; i < static_cast<int>(m_layoutsStats.size()); ++i) {
+			const CPUTracer::Stats& stats{ m_layoutsStats[i] };
+			ImGui::Text("%s: %.3f MRay/s, %.3f misses per ray", layouts[i],
+				stats.mraysPerSec, 1.0 * stats.cacheMisses / std::max<long long>(1, stats.rays));
+		}
+
+		ImGui::Text(" ");
+		if (ImGui::Button("Shadow rays: closest vs any hit")) {
+			m_shadowStats = m_pGeom->m_pCPUTracer->benchShadows(m_rtBuffer.pvInv, m_rtBuffer.whnf, m_rtBuffer.lightPos);
+		}
+
+		auto [closest, occlusion] = m_shadowStats;
+		if (closest.rays) {
+			ImGui::Text("Shadow rays: %lld, occluded: %lld", closest.rays, occlusion.hits);
+			ImGui::Text("Closest hit: %.3f MRay/s, %.3f nodes per ray", closest.mraysPerSec, 1.0 * closest.nodesVisited / closest.rays);
+			ImGui::Text("Any hit: %.3f MRay/s, %.3f nodes per ray", occlusion.mraysPerSec, 1.0 * occlusion.nodesVisited / occlusion.rays);
+			ImGui::Text("Speedup: %.2f", closest.timeMs / occlusion.timeMs);
+		}
+
+		ImGui::Text(" ");
+		if (ImGui::Button("Secondary rays: single vs stream")) {
+			m_secondaryStats = m_pGeom->m_pCPUTracer->benchSecondary(m_rtBuffer.pvInv, m_rtBuffer.whnf);
+		}
+		ImGui::DragInt("Stream chunk", &m_pGeom->m_pCPUTracer->m_streamChunk, 64, 64, 1 << 16);
+
+		auto [single, stream] = m_secondaryStats;
+		if (single.rays) {
+			ImGui::Text("Secondary rays: %lld, hits: %lld / %lld", single.rays, single.hits, stream.hits);
+			ImGui::Text("Single: %.3f MRay/s, %.3f misses per ray", single.mraysPerSec, 1.0 * single.cacheMisses / single.rays);
+			ImGui::Text("Stream: %.3f MRay/s, %.3f misses per ray", stream.mraysPerSec, 1.0 * stream.cacheMisses / stream.rays);
+			ImGui::Text("Speedup: %.2f", single.timeMs / stream.timeMs);
+		}
+
+		ImGui::Text(" ");
+		if (ImGui::Button("Wavefront path tracing")) {
+			m_wavefrontStats = m_pGeom->m_pWavefront->render(m_rtBuffer.pvInv, m_rtBuffer.whnf, m_rtBuffer.lightPos, m_wavefrontSamples);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Reset")) {
+			m_pGeom->m_pWavefront->reset();
+		}
+		ImGui::DragInt("Samples per pixel", &m_wavefrontSamples, 1, 1, 256);
+		ImGui::DragInt("Max depth", &m_pGeom->m_pWavefront->m_maxDepth, 1, 1, 16);
+		if (ImGui::Checkbox("Sobol sampling", &m_pGeom->m_pWavefront->m_isSobol)) {
+			m_pGeom->m_pWavefront->reset();
+		}
+
+		const WavefrontRenderer::Stats& wf{ m_wavefrontStats };
+		if (wf.samplesCnt) {
+			ImGui::Text("Accumulated samples: %i", wf.samplesCnt);
+			ImGui::Text("Rays: %lld extend, %lld shadow, %.3f MRay/s", wf.extendRays, wf.shadowRays, wf.mraysPerSec);
+			ImGui::Text("Generate (ms): %.3f", wf.generateMs);
+			ImGui::Text("Extend (ms): %.3f", wf.extendMs);
+			ImGui::Text("Shade (ms): %.3f", wf.shadeMs);
+			ImGui::Text("Shadow (ms): %.3f", wf.shadowMs);
+			ImGui::Text("Accumulate (ms): %.3f", wf.accumulateMs);
+		}
+
 		ImGui::End();
 	}
 
@@ -5,6 +5,7 @@
 #include <chrono>
 
 #include "Camera.h"
+#include "CameraPath.h"
 #include "InputHandler.h"
 #include "PostProcess.h"
 #include "Geometry.h"
@@ -48,6 +49,8 @@ class Renderer {
 		DirectX::XMINT4 instsAlgLeafsTCheck{ 1, 2, 1, 1 };
 		DirectX::SimpleMath::Vector4 camDir{};
 		DirectX::XMINT4 highligths{};
+		DirectX::SimpleMath::Vector4 lightPos{ 0.f, 10.f, 0.f, 1.f };
+		DirectX::XMINT4 shadows{};
 	};
 	RTBuffer m_rtBuffer{};
 	ID3D11Buffer* m_pRTBuffer{};
@@ -66,6 +69,12 @@ class Renderer {
 
 	Camera* m_pCamera{};
 
+	// recorded with R, played back with P
+	const std::string m_cameraPathFile{ "camera.path" };
+	CameraPath m_cameraPath{};
+	bool m_isCameraRecording{};
+	int m_cameraPlayFrame{ -1 };
+
 	Geometry* m_pGeom{};
 	double m_geomGPUFrameAvgTime{};
 	double m_geomGPUAccTime{};
@@ -76,6 +85,13 @@ class Renderer {
 
 	bool m_isModelRotate{};
 
+	CPUTracer::Stats m_cpuStats{};
+	std::vector<CPUTracer::Stats> m_layoutsStats{};
+	std::pair<CPUTracer::Stats, CPUTracer::Stats> m_shadowStats{};
+	std::pair<CPUTracer::Stats, CPUTracer::Stats> m_secondaryStats{};
+	WavefrontRenderer::Stats m_wavefrontStats{};
+	int m_wavefrontSamples{ 1 };
+
 	// time
 	CPUTimer m_CPUTimer{};
 	double m_prevTime{};
@@ -91,6 +107,8 @@ public:
 	InputHandler* m_pInputHandler{};
 
 	void switchRotation();
+	void switchCameraRecording();
+	void switchCameraPlayback();
 
 	bool init(HWND hWnd);
 	void term();
@@ -0,0 +1,273 @@
+#include "SceneGenerator.h"
+
+#include <random>
+#include <sstream>
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+#include "../utils/DirectXTK/Src/TeapotData.inc"
+
+	// scenes fit into cube of this half size around origin
+	constexpr float Extent{ 5.f };
+
+	using Indices = std::vector<XMUINT3>;
+	using Vertices = std::vector<XMFLOAT3>;
+
+	Vector3 randomDir(std::mt19937& gen) {
+		std::normal_distribution<float> normal{};
+		Vector3 dir{ normal(gen), normal(gen), normal(gen) };
+		dir.Normalize();
+		return dir;
+	}
+
+	void addTri(Indices& indices, Vertices& vertices, const Vector3& v0, const Vector3& v1, const Vector3& v2) {
+		UINT base{ static_cast<UINT>(vertices.size()) };
+		vertices.push_back(v0);
+		vertices.push_back(v1);
+		vertices.push_back(v2);
+		indices.push_back({ base, base + 1, base + 2 });
+	}
+
+	// triangle size shrinks with count so scene density stays similar
+	void uniform(Indices& indices, Vertices& vertices, size_t trisCnt, std::mt19937& gen) {
+		std::uniform_real_distribution<float> pos{ -Extent, Extent };
+		float size{ 2.f * Extent / std::cbrt(static_cast<float>(trisCnt)) };
+		std::uniform_real_distribution<float> offset{ -size, size };
+
+		for (size_t i{}; i < trisCnt; ++i) {
+			Vector3 ctr{ pos(gen), pos(gen), pos(gen) };
+			addTri(indices, vertices,
+				ctr + Vector3{ offset(gen), offset(gen), offset(gen) },
+				ctr + Vector3{ offset(gen), offset(gen), offset(gen) },
+				ctr + Vector3{ offset(gen), offset(gen), offset(gen) }
+			);
+		}
+	}
+
+	// long slivers in random directions, their boxes overlap a lot so sbvh splits pay off
+	void thin(Indices& indices, Vertices& vertices, size_t trisCnt, std::mt19937& gen) {
+		std::uniform_real_distribution<float> pos{ -Extent, Extent };
+		std::uniform_real_distribution<float> length{ .1f * Extent, .5f * Extent };
+
+		for (size_t i{}; i < trisCnt; ++i) {
+			Vector3 v0{ pos(gen), pos(gen), pos(gen) };
+			Vector3 dir{ randomDir(gen) };
+			Vector3 side{ dir.Cross(randomDir(gen)) };
+			side.Normalize();
+
+			float len{ length(gen) };
+			addTri(indices, vertices, v0, v0 + len * dir, v0 + len * dir + 1e-3f * len * side);
+		}
+	}
+
+	// curly strands grown from sphere, every segment is thin quad of two triangles
+	void hair(Indices& indices, Vertices& vertices, size_t trisCnt, std::mt19937& gen) {
+		constexpr int SegmentsCnt{ 32 };
+		float segment{ .5f * Extent / SegmentsCnt };
+		float width{ .05f * segment };
+
+		while (indices.size() < trisCnt) {
+			Vector3 dir{ randomDir(gen) };
+			Vector3 pos{ .4f * Extent * dir };
+
+			for (int s{}; s < SegmentsCnt && indices.size() < trisCnt; ++s) {
+				Vector3 next{ pos + segment * dir };
+				Vector3 side{ dir.Cross(randomDir(gen)) };
+				side.Normalize();
+				side *= width;
+
+				UINT base{ static_cast<UINT>(vertices.size()) };
+				vertices.push_back(pos - side);
+				vertices.push_back(pos + side);
+				vertices.push_back(next - side);
+				vertices.push_back(next + side);
+				indices.push_back({ base, base + 1, base + 2 });
+				if (indices.size() < trisCnt)
+					indices.push_back({ base + 2, base + 1, base + 3 });
+
+				dir += .3f * randomDir(gen);
+				dir.Normalize();
+				pos = next;
+			}
+		}
+	}
+
+	// port of DirectX::ComputeTeapot without 16 bit index limit, positions only
+	void teapot(Indices& indices, Vertices& vertices, float size, UINT tessellation) {
+		auto patch = [&](const TeapotPatch& patch, const Vector3& scale, bool isMirrored) {
+			Vector3 points[16]{};
+			for (int i{}; i < 16; ++i)
+				points[i] = scale * Vector3{ TeapotControlPoints[patch.indices[i]] };
+
+			auto cubic = [](const Vector3& p1, const Vector3& p2, const Vector3& p3, const Vector3& p4, float t) {
+				float s{ 1.f - t };
+				return s * s * s * p1 + 3.f * s * s * t * p2 + 3.f * s * t * t * p3 + t * t * t * p4;
+			};
+
+			UINT base{ static_cast<UINT>(vertices.size()) };
+			for (UINT i{}; i <= tessellation; ++i) {
+				float u{ static_cast<float>(i) / tessellation };
+				Vector3 p1{ cubic(points[0], points[1], points[2], points[3], u) };
+				Vector3 p2{ cubic(points[4], points[5], points[6], points[7], u) };
+				Vector3 p3{ cubic(points[8], points[9], points[10], points[11], u) };
+				Vector3 p4{ cubic(points[12], points[13], points[14], points[15], u) };
+
+				for (UINT j{}; j <= tessellation; ++j)
+					vertices.push_back(cubic(p1, p2, p3, p4, static_cast<float>(j) / tessellation));
+			}
+
+			UINT stride{ tessellation + 1 };
+			for (UINT i{}; i < tessellation; ++i) {
+				for (UINT j{}; j < tessellation; ++j) {
+					XMUINT3 t0{ base + i * stride + j, base + (i + 1) * stride + j, base + (i + 1) * stride + j + 1 };
+					XMUINT3 t1{ base + i * stride + j, base + (i + 1) * stride + j + 1, base + i * stride + j + 1 };
+					if (isMirrored) {
+						std::swap(t0.x, t0.z);
+						std::swap(t1.x, t1.z);
+					}
+					indices.push_back(t0);
+					indices.push_back(t1);
+				}
+			}
+		};
+
+		for (const TeapotPatch& p : TeapotPatches) {
+			patch(p, { size, size, size }, false);
+			patch(p, { -size, size, size }, true);
+			if (p.mirrorZ) {
+				patch(p, { size, size, -size }, true);
+				patch(p, { -size, size, -size }, false);
+			}
+		}
+	}
+
+	// octahedron faces split into tessellation^2 triangles and pushed onto sphere,
+	// power of two levels match DirectX::ComputeGeoSphere subdivisions
+	void geoSphere(Indices& indices, Vertices& vertices, float radius, UINT tessellation) {
+		const Vector3 corners[]{ { 0, 1, 0 }, { 0, 0, -1 }, { 1, 0, 0 }, { 0, 0, 1 }, { -1, 0, 0 }, { 0, -1, 0 } };
+		const XMUINT3 faces[]{ { 0, 1, 2 }, { 0, 2, 3 }, { 0, 3, 4 }, { 0, 4, 1 }, { 5, 1, 4 }, { 5, 4, 3 }, { 5, 3, 2 }, { 5, 2, 1 } };
+
+		for (const XMUINT3& face : faces) {
+			const Vector3& a{ corners[face.x] };
+			const Vector3& b{ corners[face.y] };
+			const Vector3& c{ corners[face.z] };
+
+			// row i has tessellation - i + 1 vertices
+			UINT base{ static_cast<UINT>(vertices.size()) };
+			std::vector<UINT> rows{};
+			for (UINT i{}; i <= tessellation; ++i) {
+				rows.push_back(static_cast<UINT>(vertices.size()) - base);
+				for (UINT j{}; j <= tessellation - i; ++j) {
+					Vector3 v{ a + (b - a) * (static_cast<float>(i) / tessellation) + (c - a) * (static_cast<float>(j) / tessellation) };
+					v.Normalize();
+					vertices.push_back(radius * v);
+				}
+			}
+
+			for (UINT i{}; i < tessellation; ++i) {
+				for (UINT j{}; j < tessellation - i; ++j) {
+					UINT v0{ base + rows[i] + j };
+					UINT v1{ base + rows[i + 1] + j };
+					indices.push_back({ v0, v1, v0 + 1 });
+					if (j + 1 < tessellation - i)
+						indices.push_back({ v0 + 1, v1, v1 + 1 });
+				}
+			}
+		}
+	}
+
+	// small teapots with random rotation and scale gathered around few cluster centers
+	void instances(Indices& indices, Vertices& vertices, size_t trisCnt, std::mt19937& gen) {
+		Indices baseIndices{};
+		Vertices baseVertices{};
+		teapot(baseIndices, baseVertices, 1.f, 2);
+
+		size_t instancesCnt{ (trisCnt + baseIndices.size() - 1) / baseIndices.size() };
+		size_t clustersCnt{ std::max<size_t>(1, static_cast<size_t>(std::sqrt(instancesCnt) / 2)) };
+
+		std::uniform_real_distribution<float> pos{ -.8f * Extent, .8f * Extent };
+		std::vector<Vector3> clusters(clustersCnt);
+		for (Vector3& c : clusters)
+			c = { pos(gen), pos(gen), pos(gen) };
+
+		float spread{ Extent / std::cbrt(static_cast<float>(clustersCnt)) / 2.f };
+		float scale{ spread / std::cbrt(static_cast<float>(instancesCnt / clustersCnt + 1)) };
+		std::normal_distribution<float> offset{ 0.f, spread / 2.f };
+		std::uniform_real_distribution<float> scales{ .25f * scale, scale };
+		std::uniform_real_distribution<float> angle{ 0.f, XM_2PI };
+		std::uniform_int_distribution<size_t> cluster{ 0, clustersCnt - 1 };
+
+		for (size_t i{}; i < instancesCnt; ++i) {
+			Matrix model{
+				Matrix::CreateScale(scales(gen))
+				* Matrix::CreateFromYawPitchRoll(angle(gen), angle(gen), angle(gen))
+				* Matrix::CreateTranslation(clusters[cluster(gen)] + Vector3{ offset(gen), offset(gen), offset(gen) })
+			};
+
+			UINT base{ static_cast<UINT>(vertices.size()) };
+			for (const XMFLOAT3& v : baseVertices)
+				vertices.push_back(Vector3::Transform(v, model));
+			for (size_t t{}; t < baseIndices.size() && indices.size() < trisCnt; ++t)
+				indices.push_back({ base + baseIndices[t].x, base + baseIndices[t].y, base + baseIndices[t].z });
+		}
+	}
+}
+
+bool SceneGenerator::isSpec(const std::string& name) {
+	return name.rfind("gen:", 0) == 0;
+}
+
+bool SceneGenerator::generate(
+	const std::string& spec,
+	std::vector<XMUINT3>* indices,
+	std::vector<XMFLOAT3>* vertices
+) {
+	if (!isSpec(spec))
+		return false;
+
+	std::vector<std::string> parts{};
+	std::istringstream stream{ spec.substr(4) };
+	for (std::string part{}; std::getline(stream, part, ':');)
+		parts.push_back(part);
+	if (parts.size() < 2)
+		return false;
+
+	const std::string& kind{ parts[0] };
+	size_t trisCnt{};
+	int seed{ 1 };
+	try {
+		trisCnt = std::stoull(parts[1]);
+		if (parts.size() > 2)
+			seed = std::stoi(parts[2]);
+	}
+	catch (...) {
+		return false;
+	}
+	if (!trisCnt || trisCnt > (std::numeric_limits<int>::max)())
+		return false;
+
+	std::mt19937 gen{ static_cast<unsigned>(seed) };
+	indices->clear();
+	vertices->clear();
+
+	if (kind == "uniform")
+		uniform(*indices, *vertices, trisCnt, gen);
+	else if (kind == "thin")
+		thin(*indices, *vertices, trisCnt, gen);
+	else if (kind == "hair")
+		hair(*indices, *vertices, trisCnt, gen);
+	else if (kind == "instances")
+		instances(*indices, *vertices, trisCnt, gen);
+	// teapot has 32 patches of 2 * tessellation^2 triangles
+	else if (kind == "teapot")
+		teapot(*indices, *vertices, Extent / 3.f, std::max<UINT>(1, static_cast<UINT>(std::lround(std::sqrt(trisCnt / 64.)))));
+	// 8 faces of tessellation^2 triangles
+	else if (kind == "geosphere")
+		geoSphere(*indices, *vertices, Extent, std::max<UINT>(1, static_cast<UINT>(std::lround(std::sqrt(trisCnt / 8.)))));
+	else
+		return false;
+
+	return !indices->empty();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "framework.h"
+
+#include <vector>
+
+// procedural scenes for scaling studies, named "gen:<kind>:<tris>[:<seed>]" where kind is
+// uniform, thin, hair, instances, teapot or geosphere, same name always gives same mesh
+struct SceneGenerator {
+	static bool isSpec(const std::string& name);
+
+	// tessellated kinds pick level closest to tris, others give exactly tris triangles
+	static bool generate(
+		const std::string& spec,
+		std::vector<DirectX::XMUINT3>* indices,
+		std::vector<DirectX::XMFLOAT3>* vertices
+	);
+};
@@ -0,0 +1,110 @@
+#include "SobolSampler.h"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+#include "SobolMatrices.h"
+
+namespace {
+	uint32_t hash(uint32_t x) {
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	uint32_t reverseBits(uint32_t x) {
+		x = (x << 16) | (x >> 16);
+		x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+		x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+		x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+		x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+		return x;
+	}
+}
+
+int SobolSampler::getTableDimsCnt() {
+	return Sobol::NumSobolDimensions;
+}
+
+int SobolSampler::getDimsCnt() const {
+	return m_dimsCnt;
+}
+
+const uint32_t* SobolSampler::matrix(int dim) {
+	return Sobol::matrix(dim % Sobol::NumSobolDimensions);
+}
+
+uint32_t SobolSampler::scrambleSeed(uint32_t seed, int dim) {
+	return hash(seed ^ hash(static_cast<uint32_t>(dim) + 0x9e3779b9u));
+}
+
+// nested uniform scramble by Laine-Karras hash on reversed bits
+uint32_t SobolSampler::owenScramble(uint32_t v, uint32_t seed) {
+	v = reverseBits(v);
+	v += seed;
+	v ^= v * 0x6c50b47cu;
+	v ^= v * 0xb82f1e52u;
+	v ^= v * 0xc7afe638u;
+	v ^= v * 0x8d22f6e6u;
+	return reverseBits(v);
+}
+
+float SobolSampler::toFloat(uint32_t v) {
+	return std::min<float>(v * 0x1p-32f, 1.f - std::numeric_limits<float>::epsilon() / 2);
+}
+
+uint32_t SobolSampler::sobol(uint32_t gray, int dim) {
+	const uint32_t* columns{ matrix(dim) };
+
+	uint32_t v{};
+	for (; gray; gray &= gray - 1)
+		v ^= columns[std::countr_zero(gray)];
+
+	return v;
+}
+
+uint32_t SobolSampler::pixelSeed(uint32_t pixelId) const {
+	return hash(pixelId ^ m_seed);
+}
+
+float SobolSampler::sample(uint32_t pixelId, uint32_t index, int dim) const {
+	return toFloat(owenScramble(sobol(index ^ (index >> 1), dim), scrambleSeed(pixelSeed(pixelId), dim)));
+}
+
+void SobolSampler::startPixel(uint32_t pixelId, uint32_t index) {
+	m_pixelSeed = pixelSeed(pixelId);
+	m_index = index;
+
+	for (int d{}; d < m_dimsCnt; ++d)
+		m_values[d] = sobol(index ^ (index >> 1), d);
+}
+
+void SobolSampler::nextSample() {
+	int c{ std::countr_zero(++m_index) };
+	for (int d{}; d < m_dimsCnt; ++d)
+		m_values[d] ^= matrix(d)[c];
+}
+
+float SobolSampler::get(int dim) const {
+	return toFloat(owenScramble(m_values[dim], scrambleSeed(m_pixelSeed, dim)));
+}
+
+void SobolSampler::fillTile(int tileX, int tileY, int width, int height, int imageWidth, uint32_t firstSample, int samplesCnt, float* out) {
+	for (int y{}; y < height; ++y) {
+		for (int x{}; x < width; ++x) {
+			startPixel((tileY + y) * imageWidth + tileX + x, firstSample);
+
+			float* pixelOut{ out + (y * width + x) * samplesCnt * m_dimsCnt };
+			for (int s{}; s < samplesCnt; ++s) {
+				if (s)
+					nextSample();
+				for (int d{}; d < m_dimsCnt; ++d)
+					pixelOut[s * m_dimsCnt + d] = get(d);
+			}
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "framework.h"
+
+#include <cstdint>
+#include <vector>
+
+// Owen scrambled Sobol sequence, samples of every pixel are scrambled by own seed
+class SobolSampler {
+	int m_dimsCnt{};
+	uint32_t m_seed{};
+
+	// gray code state of current pixel
+	uint32_t m_pixelSeed{};
+	uint32_t m_index{};
+	std::vector<uint32_t> m_values{};
+
+public:
+	SobolSampler() = delete;
+	SobolSampler(int dimsCnt, uint32_t seed = 0) :
+		m_dimsCnt(dimsCnt),
+		m_seed(seed),
+		m_values(dimsCnt) {}
+
+	static int getTableDimsCnt();
+
+	// random access to sample of pixel, equal to get(dim) after startPixel(pixelId, index)
+	// dimensions past table are padded by rescrambled lower ones
+	float sample(uint32_t pixelId, uint32_t index, int dim) const;
+
+	// incremental generation in gray code order, first 2^k samples stay stratified
+	void startPixel(uint32_t pixelId, uint32_t index = 0);
+	void nextSample();
+	float get(int dim) const;
+
+	// samples of whole tile into out[((y * width + x) * samplesCnt + s) * dimsCnt + d]
+	void fillTile(int tileX, int tileY, int width, int height, int imageWidth, uint32_t firstSample, int samplesCnt, float* out);
+
+	int getDimsCnt() const;
+
+private:
+	static const uint32_t* matrix(int dim);
+	static uint32_t sobol(uint32_t gray, int dim);
+	uint32_t pixelSeed(uint32_t pixelId) const;
+	static uint32_t scrambleSeed(uint32_t seed, int dim);
+	static uint32_t owenScramble(uint32_t v, uint32_t seed);
+	static float toFloat(uint32_t v);
+};
@@ -0,0 +1,70 @@
+#include "VertexWelder.h"
+
+#include <cstring>
+#include <unordered_map>
+
+#include "Parallel.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+	struct Key {
+		uint32_t x{}, y{}, z{};
+
+		bool operator==(const Key& other) const {
+			return x == other.x && y == other.y && z == other.z;
+		}
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key& key) const {
+			uint64_t h{ key.x * 0x9e3779b97f4a7c15ull };
+			h = (h ^ key.y) * 0xff51afd7ed558ccdull;
+			h = (h ^ key.z) * 0xc4ceb9fe1a85ec53ull;
+			return static_cast<size_t>(h ^ (h >> 29));
+		}
+	};
+
+	uint32_t bits(float f) {
+		// -0 and 0 are same position
+		if (f == 0.f)
+			f = 0.f;
+		uint32_t u{};
+		std::memcpy(&u, &f, sizeof(u));
+		return u;
+	}
+}
+
+void VertexWelder::weld(
+	std::vector<DirectX::XMUINT3>* pIndices,
+	std::vector<DirectX::XMFLOAT3>* pVertices
+) {
+	std::vector<XMFLOAT3>& vertices{ *pVertices };
+	std::vector<int> remap(vertices.size());
+
+	std::unordered_map<Key, int, KeyHash> unique{};
+	unique.reserve(vertices.size());
+
+	// survivors are compacted to front keeping first occurrence order
+	int uniqueCnt{};
+	for (int i{}; i < static_cast<int>(vertices.size()); ++i) {
+		auto [it, isNew] = unique.try_emplace(
+			Key{ bits(vertices[i].x), bits(vertices[i].y), bits(vertices[i].z) },
+			uniqueCnt
+		);
+		if (isNew)
+			vertices[uniqueCnt++] = vertices[i];
+		remap[i] = it->second;
+	}
+
+	vertices.resize(uniqueCnt);
+	vertices.shrink_to_fit();
+
+	std::vector<XMUINT3>& indices{ *pIndices };
+	Parallel::forEach(0, static_cast<int>(indices.size()), [&](int i) {
+		indices[i].x = remap[indices[i].x];
+		indices[i].y = remap[indices[i].y];
+		indices[i].z = remap[indices[i].z];
+	}, 4096);
+}
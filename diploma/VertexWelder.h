@@ -0,0 +1,13 @@
+#pragma once
+
+#include "framework.h"
+
+#include <vector>
+
+struct VertexWelder {
+	// merges vertices with equal positions, indices are remapped in place
+	static void weld(
+		std::vector<DirectX::XMUINT3>* indices,
+		std::vector<DirectX::XMFLOAT3>* vertices
+	);
+};
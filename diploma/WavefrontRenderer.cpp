@@ -0,0 +1,218 @@
+#include "WavefrontRenderer.h"
+
+#include <algorithm>
+
+#include "Parallel.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+	unsigned hash(unsigned x) {
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	CPUTracer::Ray makeRay(const Vector3& orig, const Vector3& dir) {
+		return {
+			{ orig.x, orig.y, orig.z, 1.f },
+			{ dir.x, dir.y, dir.z, 0.f },
+			{ 1.f / dir.x, 1.f / dir.y, 1.f / dir.z, 0.f }
+		};
+	}
+}
+
+void WavefrontRenderer::reset() {
+	std::fill(m_accum.begin(), m_accum.end(), Vector3{});
+	m_samplesCnt = 0;
+}
+
+void WavefrontRenderer::setSeed(uint32_t seed) {
+	m_seed = seed;
+	m_sampler = SobolSampler{ 2, seed };
+	reset();
+}
+
+Vector3 WavefrontRenderer::pixel(int x, int y) const {
+	return m_accum[y * m_width + x] / static_cast<float>(std::max<int>(1, m_samplesCnt));
+}
+
+int WavefrontRenderer::getSamplesCnt() const {
+	return m_samplesCnt;
+}
+
+float WavefrontRenderer::sample(int pixel, int sampleId, int dim) const {
+	if (m_isSobol)
+		return m_sampler.sample(pixel, sampleId, dim);
+
+	return (hash(hash(pixel ^ hash(sampleId)) + dim + m_seed * 0x9e3779b9u) >> 8) * (1.f / (1u << 24));
+}
+
+WavefrontRenderer::Stats WavefrontRenderer::render(const Matrix& pvInv, const Vector4& whnf, const Vector4& lightPos, int samplesCnt) {
+	int width{ static_cast<int>(whnf.x) };
+	int height{ static_cast<int>(whnf.y) };
+	if (width != m_width || height != m_height) {
+		m_width = width;
+		m_height = height;
+		m_accum.assign(width * height, Vector3{});
+		m_frame.assign(width * height, Vector3{});
+		m_samplesCnt = 0;
+	}
+	if (pvInv != m_pvInv) {
+		m_pvInv = pvInv;
+		reset();
+	}
+
+	Stats stats{};
+	auto stage = [&](double& timeMs, auto&& f) {
+		m_timer.start();
+		f();
+		m_timer.stop();
+		timeMs += m_timer.getTime();
+	};
+
+	for (int s{}; s < samplesCnt; ++s) {
+		int sampleId{ m_samplesCnt };
+
+		stage(stats.generateMs, [&]() { generate(pvInv, whnf, sampleId); });
+
+		for (int depth{}; depth < m_maxDepth && m_extend.size(); ++depth) {
+			stats.extendRays += m_extend.size();
+			stage(stats.extendMs, [&]() { m_pTracer->intersect(m_extend); });
+
+			stage(stats.shadeMs, [&]() { shade(lightPos, whnf.w, sampleId, depth); });
+
+			stats.shadowRays += m_shadow.size();
+			stage(stats.shadowMs, [&]() { m_pTracer->occluded(m_shadow); });
+			stage(stats.accumulateMs, [&]() { accumulateShadows(); });
+		}
+
+		stage(stats.accumulateMs, [&]() { accumulate(); });
+	}
+
+	stats.totalMs = stats.generateMs + stats.extendMs + stats.shadeMs + stats.shadowMs + stats.accumulateMs;
+	stats.mraysPerSec = (stats.extendRays + stats.shadowRays) / std::max<double>(1e-3, stats.totalMs) / 1e3;
+	stats.samplesCnt = m_samplesCnt;
+
+	return stats;
+}
+
+void WavefrontRenderer::generate(const Matrix& pvInv, const Vector4& whnf, int sampleId) {
+	int cnt{ m_width * m_height };
+	m_extend.resize(cnt);
+	m_paths.resize(cnt);
+
+	Parallel::forEach(0, cnt, [&](int i) {
+		float x{ i % m_width + sample(i, sampleId, 0) };
+		float y{ i / m_width + sample(i, sampleId, 1) };
+
+		m_extend.set(i, m_pTracer->generateRay(pvInv, whnf, x, y), whnf.z, whnf.w);
+		m_paths[i] = { i, { 1.f, 1.f, 1.f } };
+		m_frame[i] = {};
+	}, Grain);
+}
+
+void WavefrontRenderer::shade(const Vector4& lightPos, float tfar, int sampleId, int depth) {
+	int cnt{ m_extend.size() };
+	m_nextExtend.resize(cnt);
+	m_nextPaths.resize(cnt);
+	m_extendKeep.assign(cnt, 0);
+	m_nextShadow.resize(cnt);
+	m_nextShadowPaths.resize(cnt);
+	m_shadowKeep.assign(cnt, 0);
+
+	bool isBounce{ depth + 1 < m_maxDepth };
+
+	// every path owns its pixel within one queue, so no write races
+	Parallel::forEach(0, cnt, [&](int i) {
+		const Path& path{ m_paths[i] };
+		CPUTracer::Ray ray{ m_extend.ray(i) };
+
+		int tId{ m_extend.tId[i] };
+		if (tId < 0) {
+			m_frame[path.pixel] += path.throughput * m_skyColor;
+			return;
+		}
+
+		Vector3 dir{ ray.dir.x, ray.dir.y, ray.dir.z };
+		Vector3 pos{ Vector3{ ray.orig.x, ray.orig.y, ray.orig.z } + m_extend.tmax[i] * dir };
+		Vector3 n{ m_pTracer->normal(tId) };
+		if (0.f < n.Dot(dir))
+			n = -n;
+
+		// direct light from point source
+		Vector3 toLight{ lightPos.x - pos.x, lightPos.y - pos.y, lightPos.z - pos.z };
+		float dist{ toLight.Length() };
+		toLight /= dist;
+		float cosLight{ n.Dot(toLight) };
+		if (0.f < cosLight) {
+			m_nextShadow.set(i, makeRay(pos, toLight), 1e-4f * dist, dist);
+			m_nextShadowPaths[i] = { path.pixel, path.throughput * (m_albedo * XM_1DIVPI * m_lightPower * cosLight / (dist * dist)) };
+			m_shadowKeep[i] = 1;
+		}
+
+		if (!isBounce)
+			return;
+
+		// cosine weighted bounce, pdf cancels with lambert
+		Vector3 t{ std::abs(n.x) > .9f ? Vector3{ 0.f, 1.f, 0.f } : Vector3{ 1.f, 0.f, 0.f } };
+		Vector3 b{ n.Cross(t) };
+		b.Normalize();
+		t = b.Cross(n);
+
+		float r{ std::sqrt(sample(path.pixel, sampleId, 2 + 2 * depth)) };
+		float phi{ XM_2PI * sample(path.pixel, sampleId, 3 + 2 * depth) };
+		Vector3 bounce{ t * (r * std::cos(phi)) + b * (r * std::sin(phi)) + n * std::sqrt(std::max<float>(0.f, 1.f - r * r)) };
+
+		m_nextExtend.set(i, makeRay(pos, bounce), 1e-4f, tfar);
+		m_nextPaths[i] = { path.pixel, path.throughput * m_albedo };
+		m_extendKeep[i] = 1;
+	}, Grain);
+
+	compact(m_shadowKeep, m_nextShadow, m_nextShadowPaths, m_shadow, m_shadowPaths);
+	compact(m_extendKeep, m_nextExtend, m_nextPaths, m_extend, m_paths);
+}
+
+void WavefrontRenderer::accumulateShadows() {
+	Parallel::forEach(0, m_shadow.size(), [&](int i) {
+		if (m_shadow.tId[i] < 0)
+			m_frame[m_shadowPaths[i].pixel] += m_shadowPaths[i].throughput;
+	}, Grain);
+}
+
+void WavefrontRenderer::accumulate() {
+	Parallel::forEach(0, m_width * m_height, [&](int i) {
+		m_accum[i] += m_frame[i];
+	}, Grain);
+
+	++m_samplesCnt;
+}
+
+int WavefrontRenderer::compact(const std::vector<unsigned char>& keep, const CPUTracer::RayStream& src, const std::vector<Path>& srcPaths, CPUTracer::RayStream& dst, std::vector<Path>& dstPaths) {
+	int cnt{ static_cast<int>(keep.size()) };
+
+	m_offsets.resize(cnt);
+	int kept{};
+	for (int i{}; i < cnt; ++i) {
+		m_offsets[i] = kept;
+		kept += keep[i];
+	}
+
+	dst.resize(kept);
+	dstPaths.resize(kept);
+
+	Parallel::forEach(0, cnt, [&](int i) {
+		if (!keep[i])
+			return;
+
+		int j{ m_offsets[i] };
+		dst.set(j, src.ray(i), src.tmin[i], src.tmax[i]);
+		dstPaths[j] = srcPaths[i];
+	}, Grain);
+
+	return kept;
+}
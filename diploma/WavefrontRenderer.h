@@ -0,0 +1,102 @@
+#pragma once
+
+#include "framework.h"
+
+#include <vector>
+
+#include "CPUTracer.h"
+#include "SobolSampler.h"
+#include "Timer.h"
+
+class CPUTracer;
+
+// path tracer split into generate, extend, shade, shadow and accumulate stages,
+// every stage is a parallel kernel over compacted ray queue
+class WavefrontRenderer {
+public:
+	struct Stats {
+		double generateMs{};
+		double extendMs{};
+		double shadeMs{};
+		double shadowMs{};
+		double accumulateMs{};
+		double totalMs{};
+		long long extendRays{};
+		long long shadowRays{};
+		double mraysPerSec{};
+		int samplesCnt{};
+	};
+
+private:
+	static constexpr int Grain{ 1024 };
+
+	struct Path {
+		int pixel{};
+		DirectX::SimpleMath::Vector3 throughput{};
+	};
+
+	CPUTracer* m_pTracer{};
+
+	int m_width{};
+	int m_height{};
+	DirectX::SimpleMath::Matrix m_pvInv{};
+
+	// radiance sum of all samples and radiance of current sample
+	std::vector<DirectX::SimpleMath::Vector3> m_accum{};
+	std::vector<DirectX::SimpleMath::Vector3> m_frame{};
+	int m_samplesCnt{};
+
+	// extend queue with its paths, shadow queue with light contributions
+	CPUTracer::RayStream m_extend{};
+	std::vector<Path> m_paths{};
+	CPUTracer::RayStream m_shadow{};
+	std::vector<Path> m_shadowPaths{};
+
+	// shade stage output in extend queue order, compacted afterwards
+	CPUTracer::RayStream m_nextExtend{};
+	std::vector<Path> m_nextPaths{};
+	std::vector<unsigned char> m_extendKeep{};
+	CPUTracer::RayStream m_nextShadow{};
+	std::vector<Path> m_nextShadowPaths{};
+	std::vector<unsigned char> m_shadowKeep{};
+	std::vector<int> m_offsets{};
+
+	uint32_t m_seed{};
+	SobolSampler m_sampler{ 2 };
+
+	CPUTimer m_timer{};
+
+public:
+	int m_maxDepth{ 3 };
+	bool m_isSobol{ true };
+	float m_albedo{ .7f };
+	float m_lightPower{ 20.f };
+	DirectX::SimpleMath::Vector3 m_skyColor{ .6f, .7f, .9f };
+
+	WavefrontRenderer() = delete;
+	WavefrontRenderer(CPUTracer* pTracer) :
+		m_pTracer(pTracer) {}
+
+	void reset();
+
+	// other seed gives independent samples for both samplers, accumulation restarts
+	void setSeed(uint32_t seed);
+
+	// adds samplesCnt samples per pixel to accumulated image, restarts after camera change
+	Stats render(const DirectX::SimpleMath::Matrix& pvInv, const DirectX::SimpleMath::Vector4& whnf, const DirectX::SimpleMath::Vector4& lightPos, int samplesCnt);
+
+	DirectX::SimpleMath::Vector3 pixel(int x, int y) const;
+	int getSamplesCnt() const;
+
+private:
+	// dimensions 0, 1 jitter pixel, 2 + 2 * depth and next one sample bounce
+	float sample(int pixel, int sampleId, int dim) const;
+
+	void generate(const DirectX::SimpleMath::Matrix& pvInv, const DirectX::SimpleMath::Vector4& whnf, int sampleId);
+	void shade(const DirectX::SimpleMath::Vector4& lightPos, float tfar, int sampleId, int depth);
+	void accumulateShadows();
+	void accumulate();
+
+	// copies kept entries of src to front of dst in order, returns kept count
+	int compact(const std::vector<unsigned char>& keep, const CPUTracer::RayStream& src, const std::vector<Path>& srcPaths, CPUTracer::RayStream& dst, std::vector<Path>& dstPaths);
+};
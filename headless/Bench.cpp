@@ -0,0 +1,257 @@
+#include "Bench.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "Parallel.h"
+
+namespace Bench {
+	BVH makeBVH(const Options& options, const MeshView& mesh) {
+		BVH bvh{ nullptr, nullptr, static_cast<unsigned>(mesh.trisCnt) };
+		bvh.setCacheOn(false);
+		if (options.has("params") && !bvh.loadParams(options.get("params", "")))
+			std::fprintf(stderr, "failed to load %s\n", options.get("params", "").c_str());
+		return bvh;
+	}
+
+	ThreadsScope::ThreadsScope(int cnt) :
+		m_prev(Parallel::threadsCnt()) {
+		Parallel::threadsCnt() = std::max<int>(1, cnt);
+	}
+
+	ThreadsScope::~ThreadsScope() {
+		Parallel::threadsCnt() = m_prev;
+	}
+
+	double percentile(std::vector<double> values, double p) {
+		if (values.empty())
+			return 0.;
+
+		std::sort(values.begin(), values.end());
+		size_t rank{ static_cast<size_t>(std::ceil(p * values.size())) };
+		return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+	}
+
+	double mannWhitneyGreater(const std::vector<double>& a, const std::vector<double>& b) {
+		size_t n1{ a.size() };
+		size_t n2{ b.size() };
+		if (!n1 || !n2)
+			return 1.;
+
+		std::vector<std::pair<double, bool>> all{};
+		for (double v : a)
+			all.push_back({ v, false });
+		for (double v : b)
+			all.push_back({ v, true });
+		std::sort(all.begin(), all.end());
+
+		// tied values share average rank
+		size_t n{ all.size() };
+		double rankSumB{};
+		double tiesSum{};
+		for (size_t i{}; i < n;) {
+			size_t j{ i };
+			while (j < n && all[j].first == all[i].first)
+				++j;
+
+			double rank{ (i + 1 + j) / 2. };
+			for (size_t k{ i }; k < j; ++k)
+				rankSumB += all[k].second ? rank : 0.;
+
+			double t{ static_cast<double>(j - i) };
+			tiesSum += t * t * t - t;
+			i = j;
+		}
+
+		// pairs with b greater than a
+		double u{ rankSumB - n2 * (n2 + 1) / 2. };
+
+		// u is distributed as coefficients of gaussian binomial (n choose n2) in q
+		if (tiesSum == 0. && n1 * n2 <= 1024) {
+			size_t uMax{ n1 * n2 };
+			std::vector<double> cnt(uMax + 1);
+			cnt[0] = 1.;
+			for (size_t k{ 1 }; k <= n2; ++k) {
+				for (size_t i{ uMax }; i >= n1 + k; --i)
+					cnt[i] -= cnt[i - n1 - k];
+				for (size_t i{ k }; i <= uMax; ++i)
+					cnt[i] += cnt[i - k];
+			}
+
+			double total{};
+			double tail{};
+			for (size_t i{}; i <= uMax; ++i) {
+				total += cnt[i];
+				tail += i >= u ? cnt[i] : 0.;
+			}
+			return tail / total;
+		}
+
+		double mean{ n1 * n2 / 2. };
+		double var{ n1 * n2 / 12. * ((n + 1) - tiesSum / (n * (n - 1.))) };
+		if (var <= 0.)
+			return 1.;
+
+		double z{ (u - mean - 0.5) / std::sqrt(var) };
+		return 0.5 * std::erfc(z / std::sqrt(2.));
+	}
+
+	std::vector<int> parseList(const std::string& str) {
+		std::vector<int> res{};
+		std::istringstream stream{ str };
+		for (std::string item{}; std::getline(stream, item, ',');) {
+			if (!item.empty())
+				res.push_back(std::stoi(item));
+		}
+		return res;
+	}
+
+	std::string jsonField(const std::string& line, const std::string& name) {
+		size_t pos{ line.find('"' + name + "\":") };
+		if (pos == std::string::npos)
+			return {};
+
+		pos = line.find_first_not_of(' ', pos + name.size() + 3);
+		if (pos == std::string::npos)
+			return {};
+
+		std::string res{};
+		if (line[pos] == '"') {
+			for (++pos; pos < line.size() && line[pos] != '"'; ++pos) {
+				if (line[pos] == '\\')
+					++pos;
+				if (pos < line.size())
+					res += line[pos];
+			}
+		}
+		else if (line[pos] == '[')
+			res = line.substr(pos + 1, line.find(']', pos) - pos - 1);
+		else
+			res = line.substr(pos, line.find_first_of(",}", pos) - pos);
+		return res;
+	}
+
+	bool parseDouble(const std::string& text, double& value) {
+		char* pEnd{};
+		value = std::strtod(text.c_str(), &pEnd);
+		if (pEnd == text.c_str())
+			return false;
+
+		for (; *pEnd; ++pEnd) {
+			if (!std::isspace(static_cast<unsigned char>(*pEnd)))
+				return false;
+		}
+		return true;
+	}
+
+	Options::Options(const Args& args) {
+		for (size_t i{}; i < args.size(); ++i) {
+			if (args[i].rfind("--", 0) == 0 && i + 1 < args.size()) {
+				m_options[args[i].substr(2)] = args[i + 1];
+				++i;
+			}
+			else
+				m_positional.push_back(args[i]);
+		}
+	}
+
+	const Args& Options::positional() const {
+		return m_positional;
+	}
+
+	bool Options::has(const std::string& name) const {
+		return m_options.contains(name);
+	}
+
+	std::string Options::get(const std::string& name, const std::string& def) const {
+		auto option{ m_options.find(name) };
+		return option == m_options.end() ? def : option->second;
+	}
+
+	int Options::getInt(const std::string& name, int def) const {
+		auto option{ m_options.find(name) };
+		return option == m_options.end() ? def : std::stoi(option->second);
+	}
+
+	double Options::getDouble(const std::string& name, double def) const {
+		auto option{ m_options.find(name) };
+		return option == m_options.end() ? def : std::stod(option->second);
+	}
+
+	std::vector<int> Options::getList(const std::string& name, const std::vector<int>& def) const {
+		auto option{ m_options.find(name) };
+		return option == m_options.end() ? def : parseList(option->second);
+	}
+
+	void Report::addRow() {
+		m_rows.emplace_back();
+	}
+
+	void Report::set(const std::string& name, double value) {
+		char text[32]{};
+		std::snprintf(text, sizeof(text), "%.6g", value);
+		m_rows.back().push_back({ name, text, true });
+	}
+
+	void Report::set(const std::string& name, const std::string& value) {
+		m_rows.back().push_back({ name, value, false });
+	}
+
+	bool Report::save(const std::string& path) const {
+		bool isJSON{ path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0 };
+		return isJSON ? saveJSON(path) : saveCSV(path);
+	}
+
+	// columns are taken from first row, all rows are expected to have them in same order
+	bool Report::saveCSV(const std::string& path) const {
+		std::ofstream file{ path };
+		if (!file)
+			return false;
+
+		if (!m_rows.empty()) {
+			for (size_t i{}; i < m_rows[0].size(); ++i)
+				file << (i ? "," : "") << m_rows[0][i].name;
+			file << '\n';
+		}
+
+		for (const auto& row : m_rows) {
+			for (size_t i{}; i < row.size(); ++i)
+				file << (i ? "," : "") << row[i].text;
+			file << '\n';
+		}
+
+		return static_cast<bool>(file);
+	}
+
+	bool Report::saveJSON(const std::string& path) const {
+		std::ofstream file{ path };
+		if (!file)
+			return false;
+
+		file << "[\n";
+		for (size_t r{}; r < m_rows.size(); ++r) {
+			file << "  {";
+			for (size_t i{}; i < m_rows[r].size(); ++i) {
+				const Cell& cell{ m_rows[r][i] };
+				file << (i ? ", " : " ") << '"' << cell.name << "\": ";
+				if (cell.isNumber)
+					file << cell.text;
+				else {
+					file << '"';
+					for (char c : cell.text)
+						file << (c == '"' || c == '\\' ? "\\" : "") << c;
+					file << '"';
+				}
+			}
+			file << (r + 1 < m_rows.size() ? " },\n" : " }\n");
+		}
+		file << "]\n";
+
+		return static_cast<bool>(file);
+	}
+}
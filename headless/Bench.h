@@ -0,0 +1,89 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "BVH.h"
+
+// shared helpers of headless benchmarks
+namespace Bench {
+	using Args = std::vector<std::string>;
+
+	// nearest rank percentile, p in [0, 1]
+	double percentile(std::vector<double> values, double p);
+
+	// one sided mann-whitney u test, p value of b being stochastically greater than a,
+	// exact for small tie free samples, normal approximation with tie correction otherwise
+	double mannWhitneyGreater(const std::vector<double>& a, const std::vector<double>& b);
+
+	// "1,2,4" -> { 1, 2, 4 }
+	std::vector<int> parseList(const std::string& str);
+
+	// value after "name": in json line written by Report or baselines, strings are unescaped,
+	// arrays come without brackets, empty if line has no such name
+	std::string jsonField(const std::string& line, const std::string& name);
+
+	// whole text is a number
+	bool parseDouble(const std::string& text, double& value);
+
+	// "--name value" pairs are options, the rest are positional
+	class Options {
+		std::map<std::string, std::string> m_options{};
+		Args m_positional{};
+
+	public:
+		Options(const Args& args);
+
+		const Args& positional() const;
+
+		bool has(const std::string& name) const;
+		std::string get(const std::string& name, const std::string& def) const;
+		int getInt(const std::string& name, int def) const;
+		double getDouble(const std::string& name, double def) const;
+		std::vector<int> getList(const std::string& name, const std::vector<int>& def) const;
+	};
+
+	// table of named columns, saved as json if path ends with .json, else as csv
+	class Report {
+		struct Cell {
+			std::string name{};
+			std::string text{};
+			bool isNumber{};
+		};
+		std::vector<std::vector<Cell>> m_rows{};
+
+	public:
+		void addRow();
+		void set(const std::string& name, double value);
+		void set(const std::string& name, const std::string& value);
+
+		bool save(const std::string& path) const;
+
+	private:
+		bool saveCSV(const std::string& path) const;
+		bool saveJSON(const std::string& path) const;
+	};
+
+	// sets tree param by its forEachParam name, unknown names are ignored
+	template <typename T>
+	void setParam(BVH& bvh, const std::string& name, T value) {
+		bvh.forEachParam([&](const char* paramName, auto& param) {
+			if (name == paramName)
+				param = static_cast<std::remove_reference_t<decltype(param)>>(value);
+		});
+	}
+
+	// tree without device and cache, "--params" file applied if given
+	BVH makeBVH(const Options& options, const MeshView& mesh);
+
+	// Parallel::threadsCnt for the lifetime of command, previous count restored on any return
+	class ThreadsScope {
+		int m_prev{};
+
+	public:
+		ThreadsScope(int cnt);
+		~ThreadsScope();
+	};
+}
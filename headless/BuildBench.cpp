@@ -0,0 +1,176 @@
+#include "BuildBench.h"
+
+#include "framework.h"
+
+#include <cstdio>
+#include <thread>
+
+#include "BVH.h"
+#include "MeshFile.h"
+#include "Parallel.h"
+#include "Profiler.h"
+#include "Timer.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+	struct Config {
+		int algBuild{};
+		int algInsert{};
+		int algSubsetBuild{};
+		int algNotSubsetBuild{};
+		int primsPerLeaf{};
+		int sahSteps{};
+	};
+
+	int getParam(BVH& bvh, const std::string& name) {
+		int value{};
+		bvh.forEachParam([&](const char* paramName, auto& param) {
+			if (name == paramName)
+				value = static_cast<int>(param);
+		});
+		return value;
+	}
+
+	// params a builder ignores keep defaults, so no config is measured twice
+	std::vector<Config> configs(const Bench::Options& options, BVH& bvh) {
+		Config def{
+			.algBuild{ getParam(bvh, "algBuild") },
+			.algInsert{ getParam(bvh, "algInsert") },
+			.algSubsetBuild{ getParam(bvh, "algSubsetBuild") },
+			.algNotSubsetBuild{ getParam(bvh, "algNotSubsetBuild") },
+			.primsPerLeaf{ getParam(bvh, "primsPerLeaf") },
+			.sahSteps{ getParam(bvh, "sahSteps") }
+		};
+
+		std::vector<Config> res{};
+		for (int algBuild : options.getList("algBuild", { 0, 1, 2, 3, 4, 5, 6 })) {
+			bool isStochastic{ algBuild == 4 };
+			bool isBinned{ algBuild == 2 || algBuild == 3 || algBuild == 4 || algBuild == 6 };
+			bool isPsr{ algBuild == 5 };
+
+			auto list = [&](bool isUsed, const std::string& name, const std::vector<int>& all, int value) {
+				return isUsed ? options.getList(name, all) : std::vector<int>{ value };
+			};
+
+			for (int algInsert : list(isStochastic, "algInsert", { 0, 1, 2 }, def.algInsert))
+			for (int algSubsetBuild : list(isStochastic, "algSubsetBuild", { 0, 1 }, def.algSubsetBuild))
+			for (int algNotSubsetBuild : list(isStochastic, "algNotSubsetBuild", { 0, 1 }, def.algNotSubsetBuild))
+			for (int primsPerLeaf : list(!isPsr, "primsPerLeaf", { 1, 2, 4 }, def.primsPerLeaf))
+			for (int sahSteps : list(isBinned, "sahSteps", { 8, 16, 32 }, def.sahSteps))
+				res.push_back({ algBuild, algInsert, algSubsetBuild, algNotSubsetBuild, primsPerLeaf, sahSteps });
+		}
+
+		return res;
+	}
+
+	void apply(BVH& bvh, const Config& config) {
+		Bench::setParam(bvh, "algBuild", config.algBuild);
+		Bench::setParam(bvh, "algInsert", config.algInsert);
+		Bench::setParam(bvh, "algSubsetBuild", config.algSubsetBuild);
+		Bench::setParam(bvh, "algNotSubsetBuild", config.algNotSubsetBuild);
+		Bench::setParam(bvh, "primsPerLeaf", config.primsPerLeaf);
+		Bench::setParam(bvh, "sahSteps", config.sahSteps);
+	}
+}
+
+namespace Bench {
+	int runBuild(const Args& args) {
+		Options options{ args };
+		if (options.positional().size() < 2) {
+			std::fprintf(stderr, "bench-build needs output path and at least one scene\n");
+			return 1;
+		}
+
+		const std::string& outPath{ options.positional()[0] };
+		int repeats{ std::max<int>(1, options.getInt("repeats", 5)) };
+		int warmups{ options.getInt("warmups", 1) };
+
+		ThreadsScope threadsScope{ Parallel::threadsCnt() };
+		int threadsMax{ std::max<int>(1, static_cast<int>(std::thread::hardware_concurrency())) };
+		std::vector<int> threadsCnts{ options.getList("threads", threadsMax > 1 ? std::vector<int>{ 1, threadsMax } : std::vector<int>{ 1 }) };
+
+		Profiler::clear();
+
+		Report report{};
+		for (size_t s{ 1 }; s < options.positional().size(); ++s) {
+			const std::string& scene{ options.positional()[s] };
+
+			MeshFile meshFile{};
+			if (!meshFile.load(scene)) {
+				std::fprintf(stderr, "failed to load %s\n", scene.c_str());
+				return 1;
+			}
+			const MeshView& mesh{ meshFile.view() };
+
+			BVH bvh{ makeBVH(options, mesh) };
+
+			for (const Config& config : configs(options, bvh)) {
+				apply(bvh, config);
+
+				for (int threads : threadsCnts) {
+					Parallel::threadsCnt() = threads;
+
+					for (int w{}; w < warmups; ++w)
+						bvh.build(mesh, Matrix::Identity);
+
+					std::vector<double> times{};
+					for (int r{}; r < repeats; ++r) {
+						CPUTimer timer{};
+						timer.start();
+						bvh.build(mesh, Matrix::Identity);
+						timer.stop();
+						times.push_back(timer.getTime());
+					}
+
+					BVH::BuildStats stats{ bvh.getBuildStats() };
+
+					report.addRow();
+					report.set("scene", scene);
+					report.set("tris", mesh.trisCnt);
+					report.set("threads", threads);
+					report.set("algBuild", config.algBuild);
+					report.set("algInsert", config.algInsert);
+					report.set("algSubsetBuild", config.algSubsetBuild);
+					report.set("algNotSubsetBuild", config.algNotSubsetBuild);
+					report.set("primsPerLeaf", config.primsPerLeaf);
+					report.set("sahSteps", config.sahSteps);
+					report.set("repeats", repeats);
+					report.set("medianMs", percentile(times, 0.5));
+					report.set("p95Ms", percentile(times, 0.95));
+					report.set("minMs", percentile(times, 0.));
+					report.set("sahCost", stats.sahCost);
+					report.set("nodes", stats.nodesCnt);
+					report.set("leafs", stats.leafsCnt);
+					report.set("wide", stats.isWide ? 1 : 0);
+					report.set("depthMin", stats.depthMin);
+					report.set("depthMax", stats.depthMax);
+					report.set("splitCnt", stats.splitCnt);
+					report.set("treeKB", stats.buildMemory / 1024.);
+
+					std::printf(
+						"%s alg %d ins %d sub %d/%d leaf %d steps %d threads %d: median %.3f ms, sah %.3f\n",
+						scene.c_str(), config.algBuild, config.algInsert, config.algSubsetBuild, config.algNotSubsetBuild,
+						config.primsPerLeaf, config.sahSteps, threads, percentile(times, 0.5), stats.sahCost
+					);
+				}
+			}
+
+			bvh.term();
+		}
+
+		if (options.has("profile") && !Profiler::IsOn)
+			std::fprintf(stderr, "built without PROFILER_ZONES, profile has no zones\n");
+		if (options.has("profile") && !Profiler::saveChromeTrace(options.get("profile", ""))) {
+			std::fprintf(stderr, "failed to write %s\n", options.get("profile", "").c_str());
+			return 1;
+		}
+
+		if (!report.save(outPath)) {
+			std::fprintf(stderr, "failed to write %s\n", outPath.c_str());
+			return 1;
+		}
+		return 0;
+	}
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "Bench.h"
+
+namespace Bench {
+	// builds every scene with every builder configuration and thread count
+	int runBuild(const Args& args);
+}
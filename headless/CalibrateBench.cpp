@@ -0,0 +1,215 @@
+#include "CalibrateBench.h"
+
+#include "framework.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "BVH.h"
+#include "CameraPath.h"
+#include "CPUTracer.h"
+#include "MeshFile.h"
+#include "Parallel.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+	// time of frame is modeled as rays, binary node visits, wide node visits and triangle tests
+	constexpr int TermsCnt{ 4 };
+	using Terms = std::array<double, TermsCnt>;
+
+	struct Sample {
+		Terms terms{};
+		double timeMs{};
+	};
+
+	// least squares by normal equations over terms not in skip,
+	// terms are scaled to unit max so system is not degenerate
+	bool solve(const std::vector<Sample>& samples, const std::array<bool, TermsCnt>& skip, Terms& coefs) {
+		Terms scale{};
+		for (const Sample& s : samples) {
+			for (int i{}; i < TermsCnt; ++i)
+				scale[i] = skip[i] ? 0. : std::max<double>(scale[i], s.terms[i]);
+		}
+
+		std::vector<int> used{};
+		for (int i{}; i < TermsCnt; ++i) {
+			if (scale[i] > 0.)
+				used.push_back(i);
+		}
+		int n{ static_cast<int>(used.size()) };
+
+		double a[TermsCnt][TermsCnt + 1]{};
+		for (const Sample& s : samples) {
+			for (int i{}; i < n; ++i) {
+				double xi{ s.terms[used[i]] / scale[used[i]] };
+				for (int j{}; j < n; ++j)
+					a[i][j] += xi * s.terms[used[j]] / scale[used[j]];
+				a[i][n] += xi * s.timeMs;
+			}
+		}
+
+		for (int c{}; c < n; ++c) {
+			int pivot{ c };
+			for (int r{ c + 1 }; r < n; ++r)
+				pivot = std::abs(a[r][c]) > std::abs(a[pivot][c]) ? r : pivot;
+			if (std::abs(a[pivot][c]) < 1e-12)
+				return false;
+			std::swap(a[c], a[pivot]);
+
+			for (int r{}; r < n; ++r) {
+				if (r == c)
+					continue;
+				double k{ a[r][c] / a[c][c] };
+				for (int j{ c }; j <= n; ++j)
+					a[r][j] -= k * a[c][j];
+			}
+		}
+
+		coefs = {};
+		for (int i{}; i < n; ++i)
+			coefs[used[i]] = a[i][n] / a[i][i] / scale[used[i]];
+		return true;
+	}
+
+	// negative costs make no sense, most negative term is dropped until none are left
+	bool fit(const std::vector<Sample>& samples, Terms& coefs) {
+		std::array<bool, TermsCnt> skip{};
+		while (solve(samples, skip, coefs)) {
+			int worst{ static_cast<int>(std::min_element(coefs.begin(), coefs.end()) - coefs.begin()) };
+			if (coefs[worst] >= 0.)
+				return true;
+			skip[worst] = true;
+		}
+		return false;
+	}
+
+	// cost lines are replaced, other lines of existing file are kept
+	bool saveCosts(const std::string& path, float costTraversal, float costTraversalWide) {
+		std::vector<std::string> lines{};
+		std::ifstream src{ path };
+		for (std::string line{}; std::getline(src, line);) {
+			std::istringstream stream{ line };
+			std::string name{};
+			stream >> name;
+			if (name != "costTraversal" && name != "costTraversalWide" && name != "costIntersect")
+				lines.push_back(line);
+		}
+		src.close();
+
+		std::ofstream file{ path };
+		for (const std::string& line : lines)
+			file << line << '\n';
+		file << "costTraversal " << costTraversal << '\n';
+		file << "costTraversalWide " << costTraversalWide << '\n';
+		file << "costIntersect 1\n";
+		return static_cast<bool>(file);
+	}
+}
+
+namespace Bench {
+	int runCalibrate(const Args& args) {
+		Options options{ args };
+		if (options.positional().size() < 3) {
+			std::fprintf(stderr, "calibrate needs params path, scene and camera path\n");
+			return 1;
+		}
+
+		const std::string& paramsPath{ options.positional()[0] };
+		const std::string& scene{ options.positional()[1] };
+		int repeats{ std::max<int>(1, options.getInt("repeats", 3)) };
+
+		CameraPath path{};
+		if (!path.load(options.positional()[2])) {
+			std::fprintf(stderr, "failed to load camera path %s\n", options.positional()[2].c_str());
+			return 1;
+		}
+
+		MeshFile meshFile{};
+		if (!meshFile.load(scene)) {
+			std::fprintf(stderr, "failed to load %s\n", scene.c_str());
+			return 1;
+		}
+		const MeshView& mesh{ meshFile.view() };
+
+		// one thread by default so frame time is sum of ray costs
+		ThreadsScope threadsScope{ options.getInt("threads", 1) };
+
+		// nominal costs while building, leaf sizes vary ratio of node visits to triangle tests
+		BVH bvh{ makeBVH(options, mesh) };
+		setParam(bvh, "algBuild", options.getInt("algBuild", 0));
+
+		// simulated cache would add its own cost to every node and triangle
+		CPUTracer tracer{ &bvh };
+		tracer.m_simulateCache = false;
+
+		std::vector<Sample> samples{};
+		for (int wide : { 0, 1 }) {
+			for (int primsPerLeaf : options.getList("primsPerLeaf", { 1, 2, 4, 8, 16 })) {
+				setParam(bvh, "toQBVH", wide != 0);
+				setParam(bvh, "primsPerLeaf", primsPerLeaf);
+				bvh.build(mesh, Matrix::Identity);
+				tracer.update(mesh, Matrix::Identity);
+
+				for (int f{}; f < path.size(); ++f) {
+					CPUTracer::Stats best{};
+					for (int r{}; r < repeats; ++r) {
+						CPUTracer::Stats stats{ tracer.traceFrame(path.pvInv(f), path.whnf()) };
+						if (!r || stats.timeMs < best.timeMs)
+							best = stats;
+					}
+
+					Sample sample{ {}, best.timeMs };
+					sample.terms[0] = static_cast<double>(best.rays);
+					sample.terms[wide ? 2 : 1] = static_cast<double>(best.nodesVisited);
+					sample.terms[3] = static_cast<double>(best.primsTested);
+					samples.push_back(sample);
+				}
+
+				std::printf("wide %d leaf %d: %zu samples\n", wide, primsPerLeaf, samples.size());
+			}
+		}
+
+		bvh.term();
+
+		Terms coefs{};
+		if (!fit(samples, coefs) || coefs[3] <= 0.) {
+			std::fprintf(stderr, "failed to fit costs, try more frames or leaf sizes\n");
+			return 1;
+		}
+
+		double mean{};
+		for (const Sample& s : samples)
+			mean += s.timeMs / samples.size();
+		double ssRes{}, ssTot{};
+		for (const Sample& s : samples) {
+			double predicted{};
+			for (int i{}; i < TermsCnt; ++i)
+				predicted += coefs[i] * s.terms[i];
+			ssRes += (s.timeMs - predicted) * (s.timeMs - predicted);
+			ssTot += (s.timeMs - mean) * (s.timeMs - mean);
+		}
+
+		std::printf(
+			"ns per ray %.2f, binary node %.2f, wide node %.2f, triangle %.2f, r2 %.4f\n",
+			1e6 * coefs[0], 1e6 * coefs[1], 1e6 * coefs[2], 1e6 * coefs[3], ssTot > 0. ? 1. - ssRes / ssTot : 1.
+		);
+
+		// costs are relative to triangle test, other params of existing file are kept
+		float costTraversal{ static_cast<float>(std::max<double>(coefs[1], 0.) / coefs[3]) };
+		float costTraversalWide{ static_cast<float>(std::max<double>(coefs[2], 0.) / coefs[3]) };
+
+		if (!saveCosts(paramsPath, costTraversal, costTraversalWide)) {
+			std::fprintf(stderr, "failed to write %s\n", paramsPath.c_str());
+			return 1;
+		}
+
+		std::printf("costTraversal %.3f, costTraversalWide %.3f, costIntersect 1 -> %s\n", costTraversal, costTraversalWide, paramsPath.c_str());
+		return 0;
+	}
+}
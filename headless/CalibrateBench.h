@@ -0,0 +1,8 @@
+#pragma once
+
+#include "Bench.h"
+
+namespace Bench {
+	// fits sah node and triangle costs to cpu traversal times and stores them in params file
+	int runCalibrate(const Args& args);
+}
@@ -0,0 +1,265 @@
+#include "GateBench.h"
+
+#include "framework.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "BVH.h"
+#include "CameraPath.h"
+#include "CPUTracer.h"
+#include "MeshFile.h"
+#include "Parallel.h"
+#include "Timer.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+	// samples of one metric of one scene built by one algorithm
+	struct Entry {
+		std::string scene{};
+		int algBuild{};
+		std::string metric{};
+		std::vector<double> samples{};
+
+		std::string key() const {
+			return scene + '|' + std::to_string(algBuild) + '|' + metric;
+		}
+	};
+
+	std::string quoted(const std::string& str) {
+		std::string res{ '"' };
+		for (char c : str) {
+			if (c == '"' || c == '\\')
+				res += '\\';
+			res += c;
+		}
+		return res + '"';
+	}
+
+	// one entry per line, so it is read back line by line
+	bool saveBaseline(const std::string& path, const std::vector<Entry>& entries) {
+		std::ofstream file{ path };
+		if (!file)
+			return false;
+
+		file << "{\n  \"version\": 1,\n  \"entries\": [\n";
+		for (size_t e{}; e < entries.size(); ++e) {
+			const Entry& entry{ entries[e] };
+			file << "    { \"scene\": " << quoted(entry.scene)
+				<< ", \"algBuild\": " << entry.algBuild
+				<< ", \"metric\": " << quoted(entry.metric)
+				<< ", \"samples\": [";
+
+			char text[32]{};
+			for (size_t i{}; i < entry.samples.size(); ++i) {
+				std::snprintf(text, sizeof(text), "%.9g", entry.samples[i]);
+				file << (i ? ", " : " ") << text;
+			}
+			file << " ] }" << (e + 1 < entries.size() ? ",\n" : "\n");
+		}
+		file << "  ]\n}\n";
+
+		return static_cast<bool>(file);
+	}
+
+	// false on unreadable file or cell, so gate fails instead of comparing with garbage
+	bool loadBaseline(const std::string& path, std::map<std::string, Entry>& res) {
+		std::ifstream file{ path };
+		if (!file)
+			return false;
+
+		for (std::string line{}; std::getline(file, line);) {
+			if (line.find("\"metric\":") == std::string::npos)
+				continue;
+
+			double algBuild{};
+			if (!Bench::parseDouble(Bench::jsonField(line, "algBuild"), algBuild) || algBuild != static_cast<int>(algBuild))
+				return false;
+
+			Entry entry{ Bench::jsonField(line, "scene"), static_cast<int>(algBuild), Bench::jsonField(line, "metric") };
+			if (entry.scene.empty() || entry.metric.empty())
+				return false;
+
+			std::istringstream samples{ Bench::jsonField(line, "samples") };
+			for (std::string sample{}; std::getline(samples, sample, ',');) {
+				if (!Bench::parseDouble(sample, entry.samples.emplace_back()))
+					return false;
+			}
+
+			res[entry.key()] = entry;
+		}
+		return !res.empty();
+	}
+}
+
+namespace Bench {
+	int runGate(const Args& args) {
+		Options options{ args };
+		if (options.positional().size() < 2) {
+			std::fprintf(stderr, "bench-gate needs baseline path and at least one scene\n");
+			return 1;
+		}
+
+		const std::string& baselinePath{ options.positional()[0] };
+		int repeats{ std::max<int>(3, options.getInt("repeats", 7)) };
+		int warmups{ options.getInt("warmups", 1) };
+		double alpha{ options.getDouble("alpha", 0.01) };
+		double threshold{ options.getDouble("threshold", 3.) / 100. };
+		bool isUpdate{ options.getInt("update", 0) != 0 || !std::filesystem::exists(baselinePath) };
+
+		CameraPath path{};
+		bool isTraced{ options.has("camera") };
+		if (isTraced && !path.load(options.get("camera", ""))) {
+			std::fprintf(stderr, "failed to load camera path %s\n", options.get("camera", "").c_str());
+			return 1;
+		}
+
+		std::map<std::string, Entry> baseline{};
+		if (!isUpdate && !loadBaseline(baselinePath, baseline)) {
+			std::fprintf(stderr, "failed to read baseline %s, expected json of bench-gate\n", baselinePath.c_str());
+			return 1;
+		}
+
+		ThreadsScope threadsScope{ options.getInt("threads", Parallel::threadsCnt()) };
+
+		std::vector<Entry> entries{};
+		for (size_t s{ 1 }; s < options.positional().size(); ++s) {
+			const std::string& scene{ options.positional()[s] };
+
+			MeshFile meshFile{};
+			if (!meshFile.load(scene)) {
+				std::fprintf(stderr, "failed to load %s\n", scene.c_str());
+				return 1;
+			}
+			const MeshView& mesh{ meshFile.view() };
+
+			BVH bvh{ makeBVH(options, mesh) };
+			CPUTracer tracer{ &bvh };
+			tracer.m_simulateCache = false;
+
+			for (int algBuild : options.getList("algBuild", { 0, 4 })) {
+				setParam(bvh, "algBuild", algBuild);
+
+				for (int w{}; w < warmups; ++w)
+					bvh.build(mesh, Matrix::Identity);
+
+				// one sample of every metric per repeat
+				Entry build{ scene, algBuild, "buildMs" };
+				Entry sah{ scene, algBuild, "sahCost" };
+				Entry trace{ scene, algBuild, "mraysPerSec" };
+				for (int r{}; r < repeats; ++r) {
+					CPUTimer timer{};
+					timer.start();
+					bvh.build(mesh, Matrix::Identity);
+					timer.stop();
+
+					build.samples.push_back(timer.getTime());
+					sah.samples.push_back(bvh.getBuildStats().sahCost);
+
+					if (!isTraced)
+						continue;
+
+					tracer.update(mesh, Matrix::Identity);
+					double timeMs{};
+					long long rays{};
+					for (int f{}; f < path.size(); ++f) {
+						CPUTracer::Stats stats{ tracer.traceFrame(path.pvInv(f), path.whnf()) };
+						timeMs += stats.timeMs;
+						rays += stats.rays;
+					}
+					trace.samples.push_back(rays / std::max<double>(timeMs, 1e-9) / 1e3);
+				}
+
+				entries.push_back(build);
+				entries.push_back(sah);
+				if (isTraced)
+					entries.push_back(trace);
+			}
+
+			bvh.term();
+		}
+
+		if (isUpdate) {
+			if (!saveBaseline(baselinePath, entries)) {
+				std::fprintf(stderr, "failed to write %s\n", baselinePath.c_str());
+				return 1;
+			}
+			std::printf("baseline saved to %s\n", baselinePath.c_str());
+			return 0;
+		}
+
+		// regression needs both significance and median change above threshold,
+		// so stable metrics do not fail on tiny but consistent shifts
+		Report report{};
+		int regressionsCnt{};
+		for (const Entry& entry : entries) {
+			bool isLowerBetter{ entry.metric != "mraysPerSec" };
+
+			double median{ percentile(entry.samples, 0.5) };
+			double medianBase{};
+			double change{};
+			double pWorse{ 1. };
+			double pBetter{ 1. };
+			std::string verdict{ "new" };
+
+			auto base{ baseline.find(entry.key()) };
+			if (base != baseline.end() && !base->second.samples.empty()) {
+				const std::vector<double>& prev{ base->second.samples };
+				medianBase = percentile(prev, 0.5);
+				change = medianBase != 0. ? median / medianBase - 1. : 0.;
+
+				pWorse = isLowerBetter ? mannWhitneyGreater(prev, entry.samples) : mannWhitneyGreater(entry.samples, prev);
+				pBetter = isLowerBetter ? mannWhitneyGreater(entry.samples, prev) : mannWhitneyGreater(prev, entry.samples);
+
+				double worse{ isLowerBetter ? change : -change };
+				if (pWorse < alpha && worse > threshold)
+					verdict = "regressed";
+				else if (pBetter < alpha && -worse > threshold)
+					verdict = "improved";
+				else
+					verdict = "ok";
+			}
+			regressionsCnt += verdict == "regressed";
+
+			report.addRow();
+			report.set("scene", entry.scene);
+			report.set("algBuild", entry.algBuild);
+			report.set("metric", entry.metric);
+			report.set("baseMedian", medianBase);
+			report.set("median", median);
+			report.set("changePct", 100. * change);
+			report.set("pWorse", pWorse);
+			report.set("verdict", verdict);
+
+			std::printf(
+				"%s alg %d %-12s %12.4g -> %12.4g (%+7.2f%%, p %.4f) %s\n",
+				entry.scene.c_str(), entry.algBuild, entry.metric.c_str(),
+				medianBase, median, 100. * change, pWorse, verdict.c_str()
+			);
+		}
+
+		// last row holds verdict of whole run
+		report.addRow();
+		report.set("scene", "all");
+		report.set("algBuild", -1);
+		report.set("metric", "all");
+		report.set("baseMedian", 0.);
+		report.set("median", 0.);
+		report.set("changePct", 0.);
+		report.set("pWorse", 1.);
+		report.set("verdict", regressionsCnt ? "fail" : "pass");
+
+		std::printf("verdict: %s, %d regressed\n", regressionsCnt ? "fail" : "pass", regressionsCnt);
+
+		std::string verdictPath{ options.get("verdict", "verdict.json") };
+		if (!report.save(verdictPath)) {
+			std::fprintf(stderr, "failed to write %s\n", verdictPath.c_str());
+			return 1;
+		}
+		return regressionsCnt ? 2 : 0;
+	}
+}
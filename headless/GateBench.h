@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Bench.h"
+
+namespace Bench {
+	// builds and traces scenes repeatedly and compares samples with stored baseline,
+	// writes baseline when it is missing or --update is set
+	int runGate(const Args& args);
+}
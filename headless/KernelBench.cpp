@@ -0,0 +1,344 @@
+#include "KernelBench.h"
+
+#include "framework.h"
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#include "BVH.h"
+#include "CPUTracer.h"
+#include "Timer.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+	// results are summed here so kernels are not optimized out
+	volatile float g_sink{};
+
+	struct SyntheticMesh {
+		std::vector<XMFLOAT3> vertices{};
+		std::vector<uint32_t> indices{};
+
+		MeshView view() const {
+			return {
+				.pVertices{ vertices.data() },
+				.verticesCnt{ static_cast<int>(vertices.size()) },
+				.pIndices{ indices.data() },
+				.trisCnt{ static_cast<int>(indices.size() / 3) }
+			};
+		}
+	};
+
+	// small triangles scattered over unit cube, same for same seed
+	SyntheticMesh syntheticMesh(int trisCnt, int seed) {
+		std::mt19937 gen{ static_cast<unsigned>(seed) };
+		std::uniform_real_distribution<float> pos{ 0.f, 1.f };
+		std::uniform_real_distribution<float> edge{ -.02f, .02f };
+
+		SyntheticMesh mesh{};
+		for (int i{}; i < trisCnt; ++i) {
+			XMFLOAT3 v0{ pos(gen), pos(gen), pos(gen) };
+			mesh.vertices.push_back(v0);
+			mesh.vertices.push_back({ v0.x + edge(gen), v0.y + edge(gen), v0.z + edge(gen) });
+			mesh.vertices.push_back({ v0.x + edge(gen), v0.y + edge(gen), v0.z + edge(gen) });
+
+			for (int k{}; k < 3; ++k)
+				mesh.indices.push_back(3 * i + k);
+		}
+		return mesh;
+	}
+
+	// median of samples, each sample runs kernel until minMs passes
+	double nsPerOp(const KernelBench::Kernel& kernel, int samples, double minMs) {
+		std::vector<double> times{};
+		for (int s{}; s < samples; ++s) {
+			CPUTimer timer{};
+			timer.start();
+
+			long long ops{};
+			double ms{};
+			do {
+				ops += kernel.run();
+				ms = timer.curr();
+			} while (ms < minMs);
+
+			times.push_back(ms * 1e6 / ops);
+		}
+		return Bench::percentile(times, 0.5);
+	}
+
+	// kernel -> ns per op from csv or json written by earlier run, false on unreadable file or cell
+	bool loadBaseline(const std::string& path, std::map<std::string, double>& res) {
+		std::ifstream file{ path };
+		if (!file)
+			return false;
+
+		bool isJSON{ path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0 };
+
+		std::string line{};
+		std::vector<std::string> header{};
+		while (std::getline(file, line)) {
+			std::string name{};
+			std::string ns{};
+			if (isJSON) {
+				// Report writes one row object per line between brackets
+				if (line.find("\"kernel\":") == std::string::npos)
+					continue;
+				name = Bench::jsonField(line, "kernel");
+				ns = Bench::jsonField(line, "nsPerOp");
+			}
+			else {
+				std::vector<std::string> cells{};
+				std::istringstream stream{ line };
+				for (std::string cell{}; std::getline(stream, cell, ',');)
+					cells.push_back(cell);
+
+				if (header.empty()) {
+					header = cells;
+					continue;
+				}
+
+				for (size_t i{}; i < std::min(header.size(), cells.size()); ++i) {
+					if (header[i] == "kernel")
+						name = cells[i];
+					else if (header[i] == "nsPerOp")
+						ns = cells[i];
+				}
+			}
+
+			if (name.empty() || !Bench::parseDouble(ns, res[name]))
+				return false;
+		}
+		return !res.empty();
+	}
+}
+
+std::vector<KernelBench::Kernel> KernelBench::kernels(const MeshView& mesh, BVH& tree, BVH& flat, CPUTracer& tracer, int seed) {
+	// prims and refs only, split kernels run over all of them
+	flat.init(mesh, Matrix::Identity);
+
+	std::mt19937 gen{ static_cast<unsigned>(seed) };
+	std::uniform_real_distribution<float> pos{ -1.f, 2.f };
+
+	int primsCnt{ flat.m_primsCnt };
+	const std::vector<BVH::Prim>& prims{ flat.m_prims };
+
+	std::vector<AABB> boxes(primsCnt);
+	std::vector<Vector4> points(primsCnt);
+	std::vector<Vector4> ctrs(primsCnt);
+	for (int i{}; i < primsCnt; ++i) {
+		boxes[i] = prims[i].bb;
+		points[i] = { pos(gen), pos(gen), pos(gen), 0.f };
+		ctrs[i] = (1 << 10) * flat.m_aabbAllCtrs.relateVecPos(prims[i].ctr);
+	}
+
+	// rays from around unit cube to points inside it
+	std::vector<CPUTracer::Ray> rays(primsCnt);
+	for (int i{}; i < primsCnt; ++i) {
+		Vector4 dir{ prims[(i * 7919) % primsCnt].ctr - points[i] };
+		dir.w = 0.f;
+		dir.Normalize();
+		rays[i] = { points[i], dir, { 1.f / dir.x, 1.f / dir.y, 1.f / dir.z, 0.f } };
+	}
+
+	std::vector<int> leafs{};
+	for (int i{}; i < tree.m_nodesUsed; ++i) {
+		if (tree.m_nodes[i].leftCntPar.y)
+			leafs.push_back(i);
+	}
+	int leafsCnt{ static_cast<int>(leafs.size()) };
+	int treePrimsCnt{ tree.m_primsCntOrig };
+
+	// whole input as one node, linked for sbvh
+	BVH::BVHNode root{ flat.m_aabbAllPrims, { 0, primsCnt, -1, 0 } };
+	for (int i{}; i < primsCnt; ++i)
+		flat.m_primRefs[i].next = i + 1;
+
+	std::vector<Kernel> res{};
+
+	res.push_back({ "AABB::grow(point)", 1, [=]() {
+		AABB bb{};
+		for (const Vector4& p : points)
+			bb.grow(p);
+		g_sink = g_sink + bb.bmax.x;
+		return static_cast<long long>(points.size());
+	} });
+
+	res.push_back({ "AABB::grow(AABB)", 1, [=]() {
+		AABB bb{};
+		for (const AABB& b : boxes)
+			bb.grow(b);
+		g_sink = g_sink + bb.bmax.x;
+		return static_cast<long long>(boxes.size());
+	} });
+
+	res.push_back({ "AABB::area", 1, [=]() {
+		float sum{};
+		for (const AABB& b : boxes)
+			sum += b.area();
+		g_sink = g_sink + sum;
+		return static_cast<long long>(boxes.size());
+	} });
+
+	res.push_back({ "AABB::bbUnion", 1, [=]() {
+		float sum{};
+		for (size_t i{ 1 }; i < boxes.size(); ++i)
+			sum += AABB::bbUnion(boxes[i - 1], boxes[i]).bmin.x;
+		g_sink = g_sink + sum;
+		return static_cast<long long>(boxes.size() - 1);
+	} });
+
+	res.push_back({ "BVH::encodeMorton", 1, [=, &flat]() {
+		unsigned sum{};
+		for (const Vector4& c : ctrs)
+			sum += flat.encodeMorton(c);
+		g_sink = g_sink + sum;
+		return static_cast<long long>(ctrs.size());
+	} });
+
+	res.push_back({ "BVH::splitBinnedSAHStoh", primsCnt, [=, &flat]() mutable {
+		int axis{}, leftCnt{}, rightCnt{};
+		float splitPos{};
+		AABB leftBb{}, rightBb{};
+		g_sink = g_sink + flat.splitBinnedSAHStoh(root, axis, splitPos, leftBb, leftCnt, rightBb, rightCnt);
+		return 1ll;
+	} });
+
+	res.push_back({ "BVH::splitSBVH", primsCnt, [=, &flat]() mutable {
+		int axis{}, leftCnt{}, rightCnt{};
+		float splitPos{};
+		AABB leftBb{}, rightBb{};
+		g_sink = g_sink + flat.splitSBVH(root, axis, splitPos, leftBb, leftCnt, rightBb, rightCnt);
+		return 1ll;
+	} });
+
+	res.push_back({ "BVH::splitPrimSmart", 1, [=, &flat]() {
+		float sum{};
+		for (int i{}; i < primsCnt; ++i) {
+			int dim{ i % 3 };
+			Vector4 ctr{ prims[i].ctr };
+			sum += flat.splitPrimSmart(prims[i], boxes[i], dim, flat.comp(ctr, dim)).first.bmax.x;
+		}
+		g_sink = g_sink + sum;
+		return static_cast<long long>(primsCnt);
+	} });
+
+	res.push_back({ "BVH::primInsertMetric", 1, [=, &tree]() {
+		float sum{};
+		for (int i{}; i < treePrimsCnt; ++i)
+			sum += tree.primInsertMetric(i, leafs[(i * 31) % leafsCnt]);
+		g_sink = g_sink + sum;
+		return static_cast<long long>(treePrimsCnt);
+	} });
+
+	res.push_back({ "BVH::findBestLeafSmartBVH", 1, [=, &tree]() {
+		long long sum{};
+		for (int i{}; i < treePrimsCnt; ++i)
+			sum += tree.findBestLeafSmartBVH(i, leafs[(i * 31) % leafsCnt]);
+		g_sink = g_sink + static_cast<float>(sum);
+		return static_cast<long long>(treePrimsCnt);
+	} });
+
+	res.push_back({ "CPUTracer::intersectAABB", 1, [=, &tracer]() {
+		float sum{};
+		for (int i{}; i < primsCnt; ++i)
+			sum += tracer.intersectAABB(rays[i], boxes[(i * 13) % primsCnt], 0.f, 10.f);
+		g_sink = g_sink + sum;
+		return static_cast<long long>(primsCnt);
+	} });
+
+	res.push_back({ "CPUTracer::intersectTri", 1, [=, &tracer]() {
+		float sum{};
+		for (int i{}; i < primsCnt; ++i) {
+			const BVH::Prim& prim{ prims[(i * 7919) % primsCnt] };
+			Vector3 v0{ prim.v0.x, prim.v0.y, prim.v0.z };
+			Vector3 e1{ prim.v1.x - v0.x, prim.v1.y - v0.y, prim.v1.z - v0.z };
+			Vector3 e2{ prim.v2.x - v0.x, prim.v2.y - v0.y, prim.v2.z - v0.z };
+			sum += tracer.intersectTri(rays[i], v0, e1, e2).t;
+		}
+		g_sink = g_sink + sum;
+		return static_cast<long long>(primsCnt);
+	} });
+
+	return res;
+}
+
+namespace Bench {
+	int runKernels(const Args& args) {
+		Options options{ args };
+		if (options.positional().empty()) {
+			std::fprintf(stderr, "bench-kernels needs output path\n");
+			return 1;
+		}
+
+		const std::string& outPath{ options.positional()[0] };
+		int primsCnt{ std::max<int>(16, options.getInt("prims", 16384)) };
+		int seed{ options.getInt("seed", 1) };
+		int samples{ std::max<int>(1, options.getInt("samples", 7)) };
+		double minMs{ static_cast<double>(std::max<int>(1, options.getInt("minMs", 20))) };
+
+		std::map<std::string, double> baseline{};
+		if (options.has("baseline") && !loadBaseline(options.get("baseline", ""), baseline)) {
+			std::fprintf(stderr, "failed to read baseline %s, expected csv or json of bench-kernels\n", options.get("baseline", "").c_str());
+			return 1;
+		}
+
+		SyntheticMesh synthetic{ syntheticMesh(primsCnt, seed) };
+		MeshView mesh{ synthetic.view() };
+
+		// binary stochastic tree with parent links, as insertion sees it
+		BVH tree{ makeBVH(options, mesh) };
+		setParam(tree, "algBuild", 4);
+		setParam(tree, "toQBVH", false);
+		setParam(tree, "algLayout", 0);
+		setParam(tree, "flatTrisOn", false);
+		tree.build(mesh, Matrix::Identity);
+
+		BVH flat{ nullptr, nullptr, static_cast<unsigned>(primsCnt) };
+		CPUTracer tracer{ &tree };
+
+		double tolerance{ options.getInt("tolerance", 10) / 100. };
+		int regressionsCnt{};
+
+		Report report{};
+		for (const KernelBench::Kernel& kernel : KernelBench::kernels(mesh, tree, flat, tracer, seed)) {
+			double ns{ nsPerOp(kernel, samples, minMs) };
+			double itemsPerSec{ kernel.items * 1e9 / ns };
+
+			report.addRow();
+			report.set("kernel", kernel.name);
+			report.set("prims", primsCnt);
+			report.set("items", kernel.items);
+			report.set("nsPerOp", ns);
+			report.set("itemsPerSec", itemsPerSec);
+
+			std::printf("%-28s %12.3f ns/op %14.4g items/s", kernel.name.c_str(), ns, itemsPerSec);
+
+			// every row has the column, csv header comes from first row, 0 without baseline entry
+			auto prev{ baseline.find(kernel.name) };
+			bool isCompared{ prev != baseline.end() && prev->second > 0. };
+			report.set("baselineRatio", isCompared ? ns / prev->second : 0.);
+
+			if (isCompared) {
+				double ratio{ ns / prev->second };
+
+				bool isRegression{ ratio > 1. + tolerance };
+				regressionsCnt += isRegression;
+				std::printf("  x%.3f%s", ratio, isRegression ? "  REGRESSION" : "");
+			}
+			std::printf("\n");
+		}
+
+		tree.term();
+		flat.term();
+
+		if (!report.save(outPath)) {
+			std::fprintf(stderr, "failed to write %s\n", outPath.c_str());
+			return 1;
+		}
+		return regressionsCnt ? 2 : 0;
+	}
+}
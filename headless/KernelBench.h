@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Bench.h"
+
+#include <functional>
+
+namespace Bench {
+	// ns per op of bvh build and traversal kernels on fixed synthetic input
+	int runKernels(const Args& args);
+}
+
+class BVH;
+class CPUTracer;
+struct MeshView;
+
+// friend of BVH and CPUTracer, wraps their private kernels
+class KernelBench {
+public:
+	struct Kernel {
+		std::string name{};
+		// items one call of run processes, e.g. prims binned by split
+		int items{ 1 };
+		// runs kernel over whole input once, returns ops done
+		std::function<long long()> run{};
+	};
+
+	// tree is built binary bvh, flat is only initialized with mesh here
+	static std::vector<Kernel> kernels(const MeshView& mesh, BVH& tree, BVH& flat, CPUTracer& tracer, int seed);
+};
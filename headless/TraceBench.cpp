@@ -0,0 +1,244 @@
+#include "TraceBench.h"
+
+#include "framework.h"
+
+#include <cstdio>
+#include <functional>
+
+#include "BVH.h"
+#include "CameraPath.h"
+#include "CPUTracer.h"
+#include "MeshFile.h"
+#include "Parallel.h"
+#include "RayStatsExport.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+	const char* ModeNames[]{ "single", "packet", "stream", "stackless" };
+
+	using TraceFn = std::function<CPUTracer::Stats(const Matrix&, const Vector4&)>;
+
+	TraceFn traceFn(CPUTracer& tracer, int mode) {
+		switch (mode) {
+		case 1:
+			return [&](const Matrix& pvInv, const Vector4& whnf) { return tracer.traceFramePackets(pvInv, whnf); };
+		case 2:
+			return [&](const Matrix& pvInv, const Vector4& whnf) { return tracer.traceFrameStream(pvInv, whnf); };
+		case 3:
+			return [&](const Matrix& pvInv, const Vector4& whnf) {
+				tracer.m_isStackless = true;
+				CPUTracer::Stats stats{ tracer.traceFrame(pvInv, whnf) };
+				tracer.m_isStackless = false;
+				return stats;
+			};
+		default:
+			return [&](const Matrix& pvInv, const Vector4& whnf) { return tracer.traceFrame(pvInv, whnf); };
+		}
+	}
+
+	// visits are summed over whole path, so layout fits path and not one frame
+	void relayoutByVisits(BVH& bvh, CPUTracer& tracer, const CameraPath& path) {
+		std::vector<unsigned> visits{};
+
+		tracer.m_countVisits = true;
+		for (int f{}; f < path.size(); ++f) {
+			tracer.traceFrame(path.pvInv(f), path.whnf());
+			visits.resize(tracer.m_nodeVisits.size());
+			for (size_t i{}; i < visits.size(); ++i)
+				visits[i] += tracer.m_nodeVisits[i];
+		}
+		tracer.m_countVisits = false;
+
+		bvh.setLayout(3);
+		bvh.reorderNodes(visits);
+	}
+
+	void setRow(Bench::Report& report, const CPUTracer::Stats& stats) {
+		double rays{ static_cast<double>(std::max<long long>(1, stats.rays)) };
+
+		report.set("rays", static_cast<double>(stats.rays));
+		report.set("hits", static_cast<double>(stats.hits));
+		report.set("ms", stats.timeMs);
+		report.set("mraysPerSec", stats.rays / std::max<double>(stats.timeMs, 1e-9) / 1e3);
+		report.set("nodesPerRay", stats.nodesVisited / rays);
+		report.set("primsPerRay", stats.primsTested / rays);
+		report.set("cacheMissesPerRay", stats.cacheMisses / rays);
+	}
+}
+
+namespace Bench {
+	int runTrace(const Args& args) {
+		Options options{ args };
+		if (options.positional().size() < 3) {
+			std::fprintf(stderr, "bench-trace needs output path, scene and at least one camera path\n");
+			return 1;
+		}
+
+		const std::string& outPath{ options.positional()[0] };
+		const std::string& scene{ options.positional()[1] };
+		int repeats{ std::max<int>(1, options.getInt("repeats", 3)) };
+
+		std::vector<CameraPath> paths(options.positional().size() - 2);
+		for (size_t i{}; i < paths.size(); ++i) {
+			if (!paths[i].load(options.positional()[i + 2])) {
+				std::fprintf(stderr, "failed to load camera path %s\n", options.positional()[i + 2].c_str());
+				return 1;
+			}
+		}
+
+		MeshFile meshFile{};
+		if (!meshFile.load(scene)) {
+			std::fprintf(stderr, "failed to load %s\n", scene.c_str());
+			return 1;
+		}
+		const MeshView& mesh{ meshFile.view() };
+
+		ThreadsScope threadsScope{ options.getInt("threads", Parallel::threadsCnt()) };
+
+		BVH bvh{ makeBVH(options, mesh) };
+		if (options.has("algBuild"))
+			setParam(bvh, "algBuild", options.getInt("algBuild", 0));
+
+		CPUTracer tracer{ &bvh };
+		tracer.m_simulateCache = options.getInt("cache", 0);
+
+		Report report{};
+		for (int wide : options.getList("wide", { 0, 1 })) {
+			for (int layout : options.getList("layouts", { 0, 1, 2, 3 })) {
+				for (size_t p{}; p < paths.size(); ++p) {
+					const CameraPath& path{ paths[p] };
+
+					setParam(bvh, "toQBVH", wide != 0);
+					bvh.setLayout(layout == 3 ? 0 : layout);
+					bvh.build(mesh, Matrix::Identity);
+					tracer.update(mesh, Matrix::Identity);
+					if (layout == 3)
+						relayoutByVisits(bvh, tracer, path);
+
+					for (int mode : options.getList("modes", { 0, 1, 2, 3 })) {
+						TraceFn trace{ traceFn(tracer, std::clamp<int>(mode, 0, 3)) };
+
+						// frame time is minimum over repeats, counters do not depend on it
+						std::vector<CPUTracer::Stats> frames(path.size());
+						for (int f{}; f < path.size(); ++f) {
+							for (int r{}; r < repeats; ++r) {
+								CPUTracer::Stats stats{ trace(path.pvInv(f), path.whnf()) };
+								if (!r || stats.timeMs < frames[f].timeMs)
+									frames[f] = stats;
+							}
+						}
+
+						auto addRow = [&](const std::string& frame, const CPUTracer::Stats& stats) {
+							report.addRow();
+							report.set("scene", scene);
+							report.set("path", options.positional()[p + 2]);
+							report.set("frame", frame);
+							report.set("mode", ModeNames[std::clamp<int>(mode, 0, 3)]);
+							report.set("wide", wide);
+							report.set("layout", layout);
+							setRow(report, stats);
+						};
+
+						CPUTracer::Stats total{};
+						for (int f{}; f < path.size(); ++f) {
+							addRow(std::to_string(f), frames[f]);
+
+							total.timeMs += frames[f].timeMs;
+							total.rays += frames[f].rays;
+							total.hits += frames[f].hits;
+							total.nodesVisited += frames[f].nodesVisited;
+							total.primsTested += frames[f].primsTested;
+							total.cacheMisses += frames[f].cacheMisses;
+						}
+						addRow("all", total);
+
+						std::printf(
+							"%s wide %d layout %d %s: %.3f MRay/s, %.3f nodes per ray\n",
+							options.positional()[p + 2].c_str(), wide, layout, ModeNames[std::clamp<int>(mode, 0, 3)],
+							total.rays / std::max<double>(total.timeMs, 1e-9) / 1e3, 1.0 * total.nodesVisited / std::max<long long>(1, total.rays)
+						);
+					}
+				}
+			}
+		}
+
+		bvh.term();
+
+		if (!report.save(outPath)) {
+			std::fprintf(stderr, "failed to write %s\n", outPath.c_str());
+			return 1;
+		}
+		return 0;
+	}
+
+	int runRayStats(const Args& args) {
+		if (!CPUTracer::IsRayStatsOn) {
+			std::fprintf(stderr, "ray-stats needs build with TRACER_STATS defined\n");
+			return 1;
+		}
+
+		Options options{ args };
+		if (options.positional().size() < 3) {
+			std::fprintf(stderr, "ray-stats needs output prefix, scene and camera path\n");
+			return 1;
+		}
+
+		const std::string& outPrefix{ options.positional()[0] };
+		const std::string& scene{ options.positional()[1] };
+
+		CameraPath path{};
+		if (!path.load(options.positional()[2])) {
+			std::fprintf(stderr, "failed to load camera path %s\n", options.positional()[2].c_str());
+			return 1;
+		}
+		int frame{ std::clamp<int>(options.getInt("frame", 0), 0, path.size() - 1) };
+
+		MeshFile meshFile{};
+		if (!meshFile.load(scene)) {
+			std::fprintf(stderr, "failed to load %s\n", scene.c_str());
+			return 1;
+		}
+		const MeshView& mesh{ meshFile.view() };
+
+		BVH bvh{ makeBVH(options, mesh) };
+		if (options.has("algBuild"))
+			setParam(bvh, "algBuild", options.getInt("algBuild", 0));
+		if (options.has("wide"))
+			setParam(bvh, "toQBVH", options.getInt("wide", 1) != 0);
+		bvh.build(mesh, Matrix::Identity);
+
+		CPUTracer tracer{ &bvh };
+		tracer.m_simulateCache = false;
+		tracer.m_isStackless = options.getInt("stackless", 0);
+		tracer.update(mesh, Matrix::Identity);
+		tracer.traceFrame(path.pvInv(frame), path.whnf());
+
+		int width{ static_cast<int>(path.whnf().x) };
+		int height{ static_cast<int>(path.whnf().y) };
+
+		bool isSaved{ true };
+		for (int i{}; i < RayStatsExport::CountersCnt; ++i) {
+			std::string name{ outPrefix + "_" + RayStatsExport::CounterNames[i] };
+			isSaved &= RayStatsExport::saveHeatmap(name + ".bmp", tracer.m_rayStats, width, height, i);
+			isSaved &= RayStatsExport::saveHistogram(name + ".csv", tracer.m_rayStats, i);
+
+			long long sum{};
+			int max{};
+			for (const CPUTracer::RayStats& ray : tracer.m_rayStats) {
+				sum += RayStatsExport::value(ray, i);
+				max = std::max<int>(max, RayStatsExport::value(ray, i));
+			}
+			std::printf("%s: mean %.3f, max %d\n", RayStatsExport::CounterNames[i], 1.0 * sum / std::max<size_t>(1, tracer.m_rayStats.size()), max);
+		}
+
+		bvh.term();
+
+		if (!isSaved) {
+			std::fprintf(stderr, "failed to write %s_*\n", outPrefix.c_str());
+			return 1;
+		}
+		return 0;
+	}
+}
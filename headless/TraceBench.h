@@ -0,0 +1,11 @@
+#pragma once
+
+#include "Bench.h"
+
+namespace Bench {
+	// replays recorded camera paths through cpu traversal for every mode, width and layout
+	int runTrace(const Args& args);
+
+	// per ray counters of one path frame as heatmaps and histograms, needs TRACER_STATS
+	int runRayStats(const Args& args);
+}
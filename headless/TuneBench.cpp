@@ -0,0 +1,285 @@
+#include "TuneBench.h"
+
+#include "framework.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+#include "BVH.h"
+#include "CameraPath.h"
+#include "CPUTracer.h"
+#include "MeshFile.h"
+#include "Parallel.h"
+#include "Timer.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+	// param of forEachParam sampled uniformly in [min, max], ints are used for modes too
+	struct Knob {
+		const char* name{};
+		float min{};
+		float max{};
+		bool isInt{};
+	};
+
+	const Knob Knobs[]{
+		{ "frmPart", .05f, .5f },
+		{ "uniform", 0.f, .5f },
+		{ "clampBase", 1.05f, 4.f },
+		{ "clampOffset", 0.f, 128.f, true },
+		{ "clampBinCnt", 8.f, 256.f, true },
+		{ "primSplitting", 0.f, 3.f, true },
+		{ "algInsert", 1.f, 2.f, true },
+		{ "insertSearchWindow", 1.f, 64.f, true },
+		{ "algInsertConds", 0.f, 3.f, true },
+		{ "algSubsetSBVHOverlap", 0.f, 1.f },
+		{ "algNotSubsetSBVHOverlap", 0.f, 1.f },
+		{ "algSBVHOverlap", 0.f, 1.f },
+		{ "algInsertSplit", 0.f, 1.f, true },
+		{ "insertSplitOvergrow", 0.f, 1.f }
+	};
+	constexpr size_t KnobsCnt{ std::size(Knobs) };
+
+	struct Config {
+		int id{};
+		std::vector<float> values{};
+
+		// results of last rung config took part in
+		int rung{ -1 };
+		double buildMs{};
+		double sahCost{};
+		double mraysPerSec{};
+
+		int rank{};
+		double crowding{};
+	};
+
+	void apply(BVH& bvh, const Config& config) {
+		for (size_t k{}; k < KnobsCnt; ++k)
+			Bench::setParam(bvh, Knobs[k].name, config.values[k]);
+	}
+
+	// first config is current params of bvh, it is kept through all rungs to compare presets with start
+	std::vector<Config> sample(BVH& bvh, int configsCnt, int seed) {
+		std::mt19937 gen{ static_cast<unsigned>(seed) };
+
+		std::vector<Config> res(configsCnt);
+		for (int c{}; c < configsCnt; ++c) {
+			res[c].id = c;
+			for (const Knob& knob : Knobs) {
+				float value{};
+				if (!c) {
+					bvh.forEachParam([&](const char* name, const auto& param) {
+						if (knob.name == std::string{ name })
+							value = static_cast<float>(param);
+					});
+				}
+				else if (knob.isInt)
+					value = static_cast<float>(std::uniform_int_distribution<int>{ static_cast<int>(knob.min), static_cast<int>(knob.max) }(gen));
+				else
+					value = std::uniform_real_distribution<float>{ knob.min, knob.max }(gen);
+				res[c].values.push_back(value);
+			}
+		}
+		return res;
+	}
+
+	// both objectives are minimized
+	std::pair<double, double> objectives(const Config& config, bool isTraced) {
+		return { config.buildMs, isTraced ? -config.mraysPerSec : config.sahCost };
+	}
+
+	bool dominates(const Config& a, const Config& b, bool isTraced) {
+		auto [a0, a1] { objectives(a, isTraced) };
+		auto [b0, b1] { objectives(b, isTraced) };
+		return a0 <= b0 && a1 <= b1 && (a0 < b0 || a1 < b1);
+	}
+
+	// non dominated sorting with crowding distance inside rank, as in nsga-ii,
+	// so extremes of front survive halving
+	void rankPareto(std::vector<Config*>& configs, bool isTraced) {
+		for (Config* c : configs) {
+			c->rank = 0;
+			for (Config* o : configs)
+				c->rank += dominates(*o, *c, isTraced);
+			c->crowding = 0.;
+		}
+
+		for (int objective{}; objective < 2; ++objective) {
+			auto value = [&](const Config* c) {
+				auto [o0, o1] { objectives(*c, isTraced) };
+				return objective ? o1 : o0;
+			};
+
+			std::vector<Config*> sorted{ configs };
+			std::sort(sorted.begin(), sorted.end(), [&](const Config* a, const Config* b) {
+				return a->rank != b->rank ? a->rank < b->rank : value(a) < value(b);
+			});
+
+			// gaps are divided by objective range within rank, so ms and sah cost weigh the same
+			for (size_t first{}; first < sorted.size();) {
+				size_t last{ first };
+				while (last + 1 < sorted.size() && sorted[last + 1]->rank == sorted[first]->rank)
+					++last;
+
+				double range{ value(sorted[last]) - value(sorted[first]) };
+				for (size_t i{ first }; i <= last; ++i) {
+					if (i == first || i == last)
+						sorted[i]->crowding = std::numeric_limits<double>::max();
+					else if (sorted[i]->crowding != std::numeric_limits<double>::max() && range > 0.)
+						sorted[i]->crowding += (value(sorted[i + 1]) - value(sorted[i - 1])) / range;
+				}
+				first = last + 1;
+			}
+		}
+
+		std::sort(configs.begin(), configs.end(), [](const Config* a, const Config* b) {
+			return a->rank != b->rank ? a->rank < b->rank : a->crowding > b->crowding;
+		});
+	}
+}
+
+namespace Bench {
+	int runTune(const Args& args) {
+		Options options{ args };
+		if (options.positional().size() < 2) {
+			std::fprintf(stderr, "tune needs output prefix and scene\n");
+			return 1;
+		}
+
+		const std::string& outPrefix{ options.positional()[0] };
+		const std::string& scene{ options.positional()[1] };
+		int configsCnt{ std::max<int>(2, options.getInt("configs", 32)) };
+		int eta{ std::max<int>(2, options.getInt("eta", 2)) };
+		int repeatsMax{ std::max<int>(1, options.getInt("maxRepeats", 8)) };
+		// halving stops before fewer configs are left, so last rung still has a front
+		size_t keepMin{ static_cast<size_t>(std::max<int>(1, options.getInt("keep", 4))) };
+
+		CameraPath path{};
+		bool isTraced{ options.has("camera") };
+		if (isTraced && !path.load(options.get("camera", ""))) {
+			std::fprintf(stderr, "failed to load camera path %s\n", options.get("camera", "").c_str());
+			return 1;
+		}
+
+		MeshFile meshFile{};
+		if (!meshFile.load(scene)) {
+			std::fprintf(stderr, "failed to load %s\n", scene.c_str());
+			return 1;
+		}
+		const MeshView& mesh{ meshFile.view() };
+
+		ThreadsScope threadsScope{ options.getInt("threads", Parallel::threadsCnt()) };
+
+		BVH bvh{ makeBVH(options, mesh) };
+		setParam(bvh, "algBuild", 4);
+
+		CPUTracer tracer{ &bvh };
+		tracer.m_simulateCache = false;
+
+		std::vector<Config> configs{ sample(bvh, configsCnt, options.getInt("seed", 1)) };
+		std::vector<Config*> alive{};
+		for (Config& c : configs)
+			alive.push_back(&c);
+
+		// every rung keeps best 1 / eta of configs and measures them with eta times more repeats
+		int repeats{ 1 };
+		for (int rung{}; ; ++rung) {
+			for (Config* config : alive) {
+				apply(bvh, *config);
+
+				std::vector<double> times{};
+				for (int r{}; r < repeats; ++r) {
+					CPUTimer timer{};
+					timer.start();
+					bvh.build(mesh, Matrix::Identity);
+					timer.stop();
+					times.push_back(timer.getTime());
+				}
+
+				config->rung = rung;
+				config->buildMs = percentile(times, 0.5);
+				config->sahCost = bvh.getBuildStats().sahCost;
+
+				if (isTraced) {
+					tracer.update(mesh, Matrix::Identity);
+					double timeMs{};
+					long long rays{};
+					for (int f{}; f < path.size(); ++f) {
+						CPUTracer::Stats stats{ tracer.traceFrame(path.pvInv(f), path.whnf()) };
+						timeMs += stats.timeMs;
+						rays += stats.rays;
+					}
+					config->mraysPerSec = rays / std::max<double>(timeMs, 1e-9) / 1e3;
+				}
+			}
+
+			rankPareto(alive, isTraced);
+
+			std::printf("rung %d, %zu configs, %d repeats: front", rung, alive.size(), repeats);
+			for (const Config* c : alive) {
+				if (!c->rank)
+					std::printf(" #%d (%.2f ms, %.3f)", c->id, c->buildMs, isTraced ? c->mraysPerSec : c->sahCost);
+			}
+			std::printf("\n");
+
+			size_t keepCnt{ alive.size() / eta };
+			if (keepCnt < keepMin)
+				break;
+
+			auto start{ std::find_if(alive.begin(), alive.end(), [](const Config* c) { return !c->id; }) };
+			if (start - alive.begin() >= static_cast<std::ptrdiff_t>(keepCnt))
+				std::iter_swap(alive.begin() + keepCnt - 1, start);
+			alive.resize(keepCnt);
+			repeats = std::min<int>(repeats * eta, repeatsMax);
+		}
+
+		Report report{};
+		for (const Config& c : configs) {
+			bool isPareto{ c.rung == alive.front()->rung && !c.rank };
+
+			report.addRow();
+			report.set("config", c.id);
+			report.set("rung", c.rung);
+			for (size_t k{}; k < KnobsCnt; ++k)
+				report.set(Knobs[k].name, c.values[k]);
+			report.set("buildMs", c.buildMs);
+			report.set("sahCost", c.sahCost);
+			report.set("mraysPerSec", c.mraysPerSec);
+			report.set("pareto", isPareto ? 1. : 0.);
+		}
+
+		// presets from fastest build to best tree
+		std::vector<const Config*> front{};
+		for (const Config* c : alive) {
+			if (!c->rank)
+				front.push_back(c);
+		}
+		std::sort(front.begin(), front.end(), [](const Config* a, const Config* b) {
+			return a->buildMs < b->buildMs;
+		});
+
+		// presets need only params, so tree is released before any early return
+		bvh.term();
+
+		int presetsCnt{};
+		for (const Config* c : front) {
+			apply(bvh, *c);
+			std::string presetPath{ outPrefix + "_pareto" + std::to_string(presetsCnt++) + ".params" };
+			if (!bvh.saveParams(presetPath)) {
+				std::fprintf(stderr, "failed to write %s\n", presetPath.c_str());
+				return 1;
+			}
+			std::printf("#%d -> %s\n", c->id, presetPath.c_str());
+		}
+
+		if (!report.save(outPrefix + ".csv")) {
+			std::fprintf(stderr, "failed to write %s.csv\n", outPrefix.c_str());
+			return 1;
+		}
+		return 0;
+	}
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Bench.h"
+
+namespace Bench {
+	// successive halving over stochastic builder params of one scene,
+	// pareto front of build time against sah cost or MRays/s is saved as params presets
+	int runTune(const Args& args);
+}
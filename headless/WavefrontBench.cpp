@@ -0,0 +1,221 @@
+#include "WavefrontBench.h"
+
+#include "framework.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "BVH.h"
+#include "CameraPath.h"
+#include "CPUTracer.h"
+#include "MeshFile.h"
+#include "Parallel.h"
+#include "RayStatsExport.h"
+#include "WavefrontRenderer.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+	// "x,y,z" -> point, default of Renderer if not given
+	Vector4 lightPos(const Bench::Options& options) {
+		Vector4 res{ 0.f, 10.f, 0.f, 1.f };
+		if (options.has("light"))
+			std::sscanf(options.get("light", "").c_str(), "%f,%f,%f", &res.x, &res.y, &res.z);
+		return res;
+	}
+
+	// radiance is clamped to [0, 1] and gamma corrected
+	Vector3 toDisplay(const Vector3& radiance) {
+		auto channel = [](float v) { return std::pow(std::clamp<float>(v, 0.f, 1.f), 1.f / 2.2f); };
+		return { channel(radiance.x), channel(radiance.y), channel(radiance.z) };
+	}
+
+	// over all pixels and channels of linear radiance
+	double rmse(const WavefrontRenderer& renderer, const std::vector<Vector3>& reference, int width) {
+		double sum{};
+		for (size_t i{}; i < reference.size(); ++i) {
+			Vector3 d{ renderer.pixel(static_cast<int>(i % width), static_cast<int>(i / width)) - reference[i] };
+			sum += d.Dot(d);
+		}
+		return std::sqrt(sum / (3. * std::max<size_t>(1, reference.size())));
+	}
+}
+
+namespace Bench {
+	int runWavefront(const Args& args) {
+		Options options{ args };
+		if (options.positional().size() < 3) {
+			std::fprintf(stderr, "bench-wavefront needs output prefix, scene and camera path\n");
+			return 1;
+		}
+
+		const std::string& outPrefix{ options.positional()[0] };
+		const std::string& scene{ options.positional()[1] };
+		int passes{ std::max<int>(1, options.getInt("passes", 4)) };
+		int samplesCnt{ std::max<int>(1, options.getInt("samples", 4)) };
+
+		CameraPath path{};
+		if (!path.load(options.positional()[2])) {
+			std::fprintf(stderr, "failed to load camera path %s\n", options.positional()[2].c_str());
+			return 1;
+		}
+		int frame{ std::clamp<int>(options.getInt("frame", 0), 0, path.size() - 1) };
+
+		MeshFile meshFile{};
+		if (!meshFile.load(scene)) {
+			std::fprintf(stderr, "failed to load %s\n", scene.c_str());
+			return 1;
+		}
+		const MeshView& mesh{ meshFile.view() };
+
+		ThreadsScope threadsScope{ options.getInt("threads", Parallel::threadsCnt()) };
+
+		BVH bvh{ makeBVH(options, mesh) };
+		if (options.has("algBuild"))
+			setParam(bvh, "algBuild", options.getInt("algBuild", 0));
+		if (options.has("wide"))
+			setParam(bvh, "toQBVH", options.getInt("wide", 1) != 0);
+		bvh.build(mesh, Matrix::Identity);
+
+		CPUTracer tracer{ &bvh };
+		tracer.m_simulateCache = false;
+		tracer.update(mesh, Matrix::Identity);
+
+		WavefrontRenderer renderer{ &tracer };
+		renderer.m_maxDepth = std::max<int>(1, options.getInt("depth", renderer.m_maxDepth));
+		renderer.m_isSobol = options.getInt("sobol", 1) != 0;
+
+		// every pass adds samples to same image, so stage times are repeated measurements
+		Report report{};
+		for (int p{}; p < passes; ++p) {
+			WavefrontRenderer::Stats stats{ renderer.render(path.pvInv(frame), path.whnf(), lightPos(options), samplesCnt) };
+
+			report.addRow();
+			report.set("pass", p);
+			report.set("samples", stats.samplesCnt);
+			report.set("generateMs", stats.generateMs);
+			report.set("extendMs", stats.extendMs);
+			report.set("shadeMs", stats.shadeMs);
+			report.set("shadowMs", stats.shadowMs);
+			report.set("accumulateMs", stats.accumulateMs);
+			report.set("totalMs", stats.totalMs);
+			report.set("extendRays", static_cast<double>(stats.extendRays));
+			report.set("shadowRays", static_cast<double>(stats.shadowRays));
+			report.set("mraysPerSec", stats.mraysPerSec);
+
+			std::printf(
+				"pass %d, %d samples: %.3f ms (generate %.3f, extend %.3f, shade %.3f, shadow %.3f, accumulate %.3f), %.3f MRay/s\n",
+				p, stats.samplesCnt, stats.totalMs, stats.generateMs, stats.extendMs, stats.shadeMs, stats.shadowMs, stats.accumulateMs, stats.mraysPerSec
+			);
+		}
+
+		int width{ static_cast<int>(path.whnf().x) };
+		int height{ static_cast<int>(path.whnf().y) };
+		bool isSaved{ RayStatsExport::saveBMP(outPrefix + ".bmp", width, height, [&](int x, int y) {
+			return toDisplay(renderer.pixel(x, y));
+		}) };
+
+		std::printf("%d samples per pixel -> %s.bmp\n", renderer.getSamplesCnt(), outPrefix.c_str());
+
+		bvh.term();
+
+		if (!isSaved || !report.save(outPrefix + ".csv")) {
+			std::fprintf(stderr, "failed to write %s.bmp or %s.csv\n", outPrefix.c_str(), outPrefix.c_str());
+			return 1;
+		}
+		return 0;
+	}
+
+	int runConvergence(const Args& args) {
+		Options options{ args };
+		if (options.positional().size() < 3) {
+			std::fprintf(stderr, "bench-convergence needs output path, scene and camera path\n");
+			return 1;
+		}
+
+		const std::string& outPath{ options.positional()[0] };
+		const std::string& scene{ options.positional()[1] };
+		int referenceSamples{ std::max<int>(1, options.getInt("reference", 1024)) };
+		std::vector<int> samplesList{ options.getList("spp", { 1, 4, 16, 64 }) };
+		std::sort(samplesList.begin(), samplesList.end());
+
+		CameraPath path{};
+		if (!path.load(options.positional()[2])) {
+			std::fprintf(stderr, "failed to load camera path %s\n", options.positional()[2].c_str());
+			return 1;
+		}
+		int frame{ std::clamp<int>(options.getInt("frame", 0), 0, path.size() - 1) };
+
+		MeshFile meshFile{};
+		if (!meshFile.load(scene)) {
+			std::fprintf(stderr, "failed to load %s\n", scene.c_str());
+			return 1;
+		}
+		const MeshView& mesh{ meshFile.view() };
+
+		ThreadsScope threadsScope{ options.getInt("threads", Parallel::threadsCnt()) };
+
+		BVH bvh{ makeBVH(options, mesh) };
+		if (options.has("algBuild"))
+			setParam(bvh, "algBuild", options.getInt("algBuild", 0));
+		if (options.has("wide"))
+			setParam(bvh, "toQBVH", options.getInt("wide", 1) != 0);
+		bvh.build(mesh, Matrix::Identity);
+
+		CPUTracer tracer{ &bvh };
+		tracer.m_simulateCache = false;
+		tracer.update(mesh, Matrix::Identity);
+
+		WavefrontRenderer renderer{ &tracer };
+		renderer.m_maxDepth = std::max<int>(1, options.getInt("depth", renderer.m_maxDepth));
+
+		Matrix pvInv{ path.pvInv(frame) };
+		Vector4 whnf{ path.whnf() };
+		Vector4 light{ lightPos(options) };
+		int width{ static_cast<int>(whnf.x) };
+		int height{ static_cast<int>(whnf.y) };
+
+		// reference uses other seed, so its error does not correlate with measured images
+		renderer.m_isSobol = false;
+		renderer.setSeed(1);
+		renderer.render(pvInv, whnf, light, referenceSamples);
+
+		std::vector<Vector3> reference(static_cast<size_t>(width) * height);
+		for (size_t i{}; i < reference.size(); ++i)
+			reference[i] = renderer.pixel(static_cast<int>(i % width), static_cast<int>(i / width));
+
+		Report report{};
+		for (int isSobol{}; isSobol < 2; ++isSobol) {
+			renderer.m_isSobol = isSobol;
+			renderer.setSeed(0);
+
+			// image is accumulated up to every spp of list in turn
+			for (int samplesCnt : samplesList) {
+				if (samplesCnt > renderer.getSamplesCnt())
+					renderer.render(pvInv, whnf, light, samplesCnt - renderer.getSamplesCnt());
+				if (samplesCnt != renderer.getSamplesCnt())
+					continue;
+
+				double error{ rmse(renderer, reference, width) };
+
+				report.addRow();
+				report.set("sampler", isSobol ? "sobol" : "random");
+				report.set("samples", samplesCnt);
+				report.set("referenceSamples", referenceSamples);
+				report.set("rmse", error);
+
+				std::printf("%s, %d samples: rmse %.5f\n", isSobol ? "sobol" : "random", samplesCnt, error);
+			}
+		}
+
+		bvh.term();
+
+		if (!report.save(outPath)) {
+			std::fprintf(stderr, "failed to write %s\n", outPath.c_str());
+			return 1;
+		}
+		return 0;
+	}
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "Bench.h"
+
+namespace Bench {
+	// wavefront path tracing of one path frame, image and per stage times of every pass
+	int runWavefront(const Args& args);
+
+	// rmse against high spp reference of hashed random and sobol samples at several spp
+	int runConvergence(const Args& args);
+}
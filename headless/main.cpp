@@ -0,0 +1,139 @@
+#include "framework.h"
+
+#include <cstdio>
+#include <functional>
+#include <map>
+
+#include "BuildBench.h"
+#include "CalibrateBench.h"
+#include "GateBench.h"
+#include "KernelBench.h"
+#include "MeshFile.h"
+#include "Timer.h"
+#include "TraceBench.h"
+#include "TuneBench.h"
+#include "WavefrontBench.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+	using Args = std::vector<std::string>;
+
+	int usage() {
+		std::printf(
+			"usage:\n"
+			"  headless convert <src.csv/obj/ply> <dst.mesh>\n"
+			"  headless bench-load <file> [repeats]\n"
+			"  headless bench-build <out.csv/json> <scene>... [--repeats 5] [--warmups 1] [--threads 1,8]\n"
+			"      [--algBuild 0,1,2,3,4,5,6] [--algInsert 0,1,2] [--algSubsetBuild 0,1] [--algNotSubsetBuild 0,1]\n"
+			"      [--primsPerLeaf 1,2,4] [--sahSteps 8,16,32] [--profile trace.json (needs PROFILER_ZONES)] [--params bvh.params]\n"
+			"  headless bench-trace <out.csv/json> <scene> <camera.path>... [--repeats 3] [--threads 8] [--algBuild 4]\n"
+			"      [--modes 0,1,2,3 (single, packet, stream, stackless)] [--wide 0,1] [--layouts 0,1,2,3] [--cache 0] [--params bvh.params]\n"
+			"  headless ray-stats <out prefix> <scene> <camera.path> [--frame 0] [--stackless 0] [--wide 1] [--algBuild 4] [--params bvh.params]\n"
+			"  headless bench-kernels <out.csv/json> [--prims 16384] [--samples 7] [--minMs 20] [--seed 1]\n"
+			"      [--baseline old.csv] [--tolerance 10 (percent)]\n"
+			"  headless bench-gate <baseline.json> <scene>... [--camera orbit.path] [--algBuild 0,4] [--repeats 7]\n"
+			"      [--threads 8] [--alpha 0.01] [--threshold 3 (percent)] [--update 0] [--verdict verdict.json] [--params bvh.params]\n"
+			"  headless calibrate <bvh.params> <scene> <camera.path> [--repeats 3] [--threads 1] [--algBuild 0]\n"
+			"      [--primsPerLeaf 1,2,4,8,16]\n"
+			"  headless tune <out prefix> <scene> [--camera orbit.path] [--configs 32] [--eta 2] [--keep 4] [--maxRepeats 8]\n"
+			"      [--seed 1] [--threads 8] [--params bvh.params]\n"
+			"  headless bench-wavefront <out prefix> <scene> <camera.path> [--frame 0] [--passes 4] [--samples 4] [--depth 3]\n"
+			"      [--sobol 1] [--light 0,10,0] [--threads 8] [--wide 1] [--algBuild 4] [--params bvh.params]\n"
+			"  headless bench-convergence <out.csv/json> <scene> <camera.path> [--frame 0] [--spp 1,4,16,64] [--reference 1024]\n"
+			"      [--depth 3] [--light 0,10,0] [--threads 8] [--wide 1] [--algBuild 4] [--params bvh.params]\n"
+			"  scene may be generated instead of file: gen:<uniform|thin|hair|instances|teapot|geosphere>:<tris>[:seed]\n"
+		);
+		return 1;
+	}
+
+	int convert(const Args& args) {
+		if (args.size() < 2)
+			return usage();
+
+		CPUTimer timer{};
+		timer.start();
+		bool isOk{ MeshFile::convert(args[0], args[1]) };
+		timer.stop();
+
+		if (!isOk) {
+			std::fprintf(stderr, "failed to convert %s\n", args[0].c_str());
+			return 1;
+		}
+
+		std::printf("%s -> %s: %.3f ms\n", args[0].c_str(), args[1].c_str(), timer.getTime());
+		return 0;
+	}
+
+	// mapped data is read fully so page faults are counted in load time
+	int benchLoad(const Args& args) {
+		if (args.empty())
+			return usage();
+
+		int repeats{ args.size() > 1 ? std::stoi(args[1]) : 5 };
+
+		double timeMin{ std::numeric_limits<double>::max() };
+		double timeSum{};
+		MeshView view{};
+		for (int r{}; r < repeats; ++r) {
+			CPUTimer timer{};
+			timer.start();
+
+			MeshFile mesh{};
+			if (!mesh.load(args[0])) {
+				std::fprintf(stderr, "failed to load %s\n", args[0].c_str());
+				return 1;
+			}
+
+			view = mesh.view();
+			long long checksum{};
+			for (int i{}; i < view.trisCnt; ++i) {
+				XMUINT3 tri{ view.tri(i) };
+				checksum += tri.x + tri.y + tri.z;
+			}
+			float extent{};
+			for (int i{}; i < view.verticesCnt; ++i)
+				extent = std::max<float>(extent, std::abs(view.pVertices[i].x));
+
+			timer.stop();
+
+			timeMin = std::min<double>(timeMin, timer.getTime());
+			timeSum += timer.getTime();
+
+			if (!r)
+				std::printf("checksum: %lld, extent: %.3f\n", checksum, extent);
+		}
+
+		double sizeMB{ (view.indicesSize() + view.verticesSize()) / (1024. * 1024.) };
+		std::printf("%s: %i triangles, %i vertices, %i bit indices\n", args[0].c_str(), view.trisCnt, view.verticesCnt, 8 * view.indexSize);
+		std::printf("load time (ms): min %.3f, avg %.3f\n", timeMin, timeSum / repeats);
+		std::printf("throughput (MB/s): %.1f\n", sizeMB / timeMin * 1e3);
+		return 0;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const std::map<std::string, std::function<int(const Args&)>> commands{
+		{ "convert", convert },
+		{ "bench-load", benchLoad },
+		{ "bench-build", Bench::runBuild },
+		{ "bench-trace", Bench::runTrace },
+		{ "ray-stats", Bench::runRayStats },
+		{ "bench-kernels", Bench::runKernels },
+		{ "bench-gate", Bench::runGate },
+		{ "calibrate", Bench::runCalibrate },
+		{ "tune", Bench::runTune },
+		{ "bench-wavefront", Bench::runWavefront },
+		{ "bench-convergence", Bench::runConvergence }
+	};
+
+	if (argc < 2)
+		return usage();
+
+	auto command{ commands.find(argv[1]) };
+	if (command == commands.end())
+		return usage();
+
+	return command->second(Args(argv + 2, argv + argc));
+}